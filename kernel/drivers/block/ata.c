@@ -37,6 +37,9 @@ static struct ata_device ata_devices[NR_ATA_DEVICES] = {
 	},
 };
 
+/* request queues (one per channel : master and slave can't transfer at the same time) */
+static struct request_queue ata_queues[2];
+
 /* ata block sizes */
 static size_t ata_blocksizes[NR_ATA_DEVICES * NR_PARTITIONS] = { 0, };
 
@@ -75,41 +78,60 @@ static uint32_t ata_get_start_sector(struct ata_device *device, dev_t dev)
 }
 
 /*
- * Read from an ata device.
+ * Queue a request on an ata device.
  */
-int ata_read(struct buffer_head *bh)
+static int ata_make_request(int rw, struct buffer_head *bh)
 {
 	struct ata_device *device;
-	uint32_t start_sector;
+	uint32_t sector;
 
-	/* get ata device */
+	/* get ata device (atapi devices are read only) */
 	device = ata_get_device(bh->b_dev);
-	if (!device || !device->read)
+	if (!device || !device->start || (rw == WRITE && device->is_atapi))
 		return -EINVAL;
 
-	/* get partition start sector */
-	start_sector = ata_get_start_sector(device, bh->b_dev);
+	/* compute first sector */
+	sector = ata_get_start_sector(device, bh->b_dev) + bh->b_block * bh->b_size / device->sector_size;
+
+	return make_request(&ata_queues[device->bus], rw, bh, device->hd.dev, sector, bh->b_size / device->sector_size);
+}
 
-	return device->read(device, bh, start_sector);
+/*
+ * Read from an ata device (asynchronous : buffer is unlocked on completion).
+ */
+int ata_read(struct buffer_head *bh)
+{
+	return ata_make_request(READ, bh);
 }
 
 /*
- * Write to an ata device.
+ * Write to an ata device (asynchronous : buffer is unlocked on completion).
  */
 int ata_write(struct buffer_head *bh)
+{
+	return ata_make_request(WRITE, bh);
+}
+
+/*
+ * Start pending requests of a channel.
+ */
+static void ata_request(struct request_queue *q)
 {
 	struct ata_device *device;
-	uint32_t start_sector;
+	struct request *req;
+	int ret;
 
-	/* get ata device */
-	device = ata_get_device(bh->b_dev);
-	if (!device || !device->write)
-		return -EINVAL;
+	while ((req = blk_next_request(q)) != NULL) {
+		device = ata_get_device(req->dev);
+		ret = device->start(device, req);
 
-	/* get partition start sector */
-	start_sector = ata_get_start_sector(device, bh->b_dev);
+		/* transfer started : wait for interrupt */
+		if (!ret && device->end)
+			return;
 
-	return device->write(device, bh, start_sector);
+		/* synchronous transfer done or error */
+		end_request(q, ret == 0);
+	}
 }
 
 /*
@@ -206,7 +228,28 @@ err:
  */
 static void ata_irq_handler(struct registers *regs)
 {
-	UNUSED(regs);
+	int bus = regs->int_no == IRQ14 ? ATA_PRIMARY : ATA_SECONDARY;
+	struct request_queue *q = &ata_queues[bus];
+	struct ata_device *device;
+	struct request *req;
+	int ret;
+
+	/* no request : just acknowledge interrupt */
+	req = q->current_request;
+	if (!req) {
+		inb((bus == ATA_PRIMARY ? ATA_PRIMARY_IO : ATA_SECONDARY_IO) + ATA_REG_STATUS);
+		return;
+	}
+
+	/* end current request */
+	device = ata_get_device(req->dev);
+	ret = device->end(device, req);
+	if (ret == -EBUSY)
+		return;
+
+	/* wake up waiting tasks and start next request */
+	end_request(q, ret == 0);
+	q->request_fn(q);
 }
 
 /*
@@ -216,6 +259,10 @@ int init_ata()
 {
 	int ret, i;
 
+	/* init request queues (limited by DMA commands sector count) */
+	blk_init_queue(&ata_queues[ATA_PRIMARY], ata_request, ATA_DMA_MAX_SECTORS * ATA_SECTOR_SIZE);
+	blk_init_queue(&ata_queues[ATA_SECONDARY], ata_request, ATA_DMA_MAX_SECTORS * ATA_SECTOR_SIZE);
+
 	/* register interrupt handlers */
 	register_interrupt_handler(IRQ14, ata_irq_handler);
 	register_interrupt_handler(IRQ15, ata_irq_handler);
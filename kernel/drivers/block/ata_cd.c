@@ -67,23 +67,22 @@ static int ata_cd_read_sector(struct ata_device *device, uint32_t sector, char *
 }
 
 /*
- * Read from an ata device.
+ * Start a request (synchronous PIO transfer).
  */
-static int ata_cd_read(struct ata_device *device, struct buffer_head *bh, uint32_t start_sector)
+static int ata_cd_start(struct ata_device *device, struct request *req)
 {
-	uint32_t nb_sectors, sector;
+	struct buffer_head *bh;
+	uint32_t sector;
 	size_t i;
 	int ret;
 
-	/* compute nb sectors */
-	nb_sectors = bh->b_size / ATAPI_SECTOR_SIZE;
-	sector = start_sector + bh->b_block * bh->b_size / ATAPI_SECTOR_SIZE;
-
 	/* read sectors */
-	for (i = 0; i < nb_sectors; i++) {
-		ret = ata_cd_read_sector(device, sector + i, bh->b_data + ATAPI_SECTOR_SIZE * i);
-		if (ret)
-			return ret;
+	for (bh = req->bh, sector = req->sector; bh != NULL; bh = bh->b_reqnext) {
+		for (i = 0; i < bh->b_size / ATAPI_SECTOR_SIZE; i++, sector++) {
+			ret = ata_cd_read_sector(device, sector, bh->b_data + ATAPI_SECTOR_SIZE * i);
+			if (ret)
+				return ret;
+		}
 	}
 
 	return 0;
@@ -94,7 +93,8 @@ static int ata_cd_read(struct ata_device *device, struct buffer_head *bh, uint32
  */
 int ata_cd_init(struct ata_device *device)
 {
-	device->read = ata_cd_read;
-	device->write = NULL;
+	device->sector_size = ATAPI_SECTOR_SIZE;
+	device->start = ata_cd_start;
+	device->end = NULL;
 	return 0;
 }
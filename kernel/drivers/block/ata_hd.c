@@ -4,122 +4,125 @@
 #include <stderr.h>
 
 /*
- * Wait for operation completion.
+ * Get physical address of a buffer (0 if it can't be used for DMA).
  */
-static void ata_hd_wait(struct ata_device *device)
+static uint32_t ata_hd_dma_address(char *data)
 {
-	int status, dstatus;
-
-	for (;;) {
-		status = inb(device->bar4 + 2);
-		dstatus = inb(device->io_base + ATA_REG_STATUS);
-
-		if (!(status & 0x04))
-			continue;
-
-		if (!(dstatus & ATA_SR_BSY))
-			break;
-	}
-}
-
-/*
- * Read sectors from an ata device.
- */
-static int ata_hd_read_sectors(struct ata_device *device, uint32_t sector, uint32_t nb_sectors, char *buf)
-{
-	/* set transfert size */
-	device->prdt[0].transfert_size = nb_sectors * ATA_SECTOR_SIZE;
-
-	/* prepare DMA transfert */
-	outb(device->bar4, 0);
-	outl(device->bar4 + 0x04, (uint32_t) device->prdt);
-	outb(device->bar4 + 0x02, inb(device->bar4 + 0x02) | 0x02 | 0x04);
-
-	/* select sector */
-	outb(device->io_base + ATA_REG_CONTROL, 0x00);
-	outb(device->io_base + ATA_REG_HDDEVSEL, (device->drive == ATA_MASTER ? 0xE0 : 0xF0) | ((sector >> 24) & 0x0F));
-	outb(device->io_base + ATA_REG_FEATURES, 0x00);
-	outb(device->io_base + ATA_REG_SECCOUNT0, nb_sectors);
-	outb(device->io_base + ATA_REG_LBA0, (uint8_t) sector);
-	outb(device->io_base + ATA_REG_LBA1, (uint8_t) (sector >> 8));
-	outb(device->io_base + ATA_REG_LBA2, (uint8_t) (sector >> 16));
+	/* direct mapped kernel pages (vmalloc area lies above them and is not physically contiguous) */
+	if ((uint32_t) data >= KPAGE_START && (uint32_t) data < KPAGE_START + nr_pages * PAGE_SIZE)
+		return V2P((uint32_t) data);
 
-	/* issue read DMA command */
-	outb(device->io_base + ATA_REG_COMMAND, ATA_CMD_READ_DMA);
-	outb(device->bar4, 0x8 | 0x1);
-
-	/* wait for completion */
-	ata_hd_wait(device);
-
-	/* copy buffer */
-	memcpy(buf, device->buf, nb_sectors * ATA_SECTOR_SIZE);
+	/* identity mapped kernel heap */
+	if ((uint32_t) data < KHEAP_START + KHEAP_SIZE)
+		return (uint32_t) data;
 
 	return 0;
 }
 
 /*
- * Read from an ata device.
+ * Build physical region descriptor table of a request (DMA goes straight to buffers).
  */
-static int ata_hd_read(struct ata_device *device, struct buffer_head *bh, uint32_t start_sector)
+static int ata_hd_build_prdt(struct ata_device *device, struct request *req)
 {
-	uint32_t nb_sectors, sector;
+	uint32_t phys, start = 0, size = 0;
+	struct buffer_head *bh;
+	int n = 0;
+
+	for (bh = req->bh; bh != NULL; bh = bh->b_reqnext) {
+		/* get buffer physical address */
+		phys = ata_hd_dma_address(bh->b_data);
+		if (!phys)
+			return -EINVAL;
+
+		/* extend current entry (physically contiguous, in the same 64 KB region) */
+		if (size && start + size == phys && start / ATA_PRD_MAX_SIZE == (phys + bh->b_size - 1) / ATA_PRD_MAX_SIZE) {
+			size += bh->b_size;
+			continue;
+		}
+
+		/* close current entry */
+		if (size) {
+			device->prdt[n].buffer_phys = start;
+			device->prdt[n].transfert_size = (uint16_t) size;
+			device->prdt[n].mark_end = 0;
+			n++;
+		}
+
+		/* start a new entry */
+		start = phys;
+		size = bh->b_size;
+	}
 
-	/* compute nb sectors */
-	nb_sectors = bh->b_size / ATA_SECTOR_SIZE;
-	sector = start_sector + bh->b_block * bh->b_size / ATA_SECTOR_SIZE;
+	/* close last entry */
+	device->prdt[n].buffer_phys = start;
+	device->prdt[n].transfert_size = (uint16_t) size;
+	device->prdt[n].mark_end = 0x8000;
 
-	/* read sectors */
-	return ata_hd_read_sectors(device, sector, nb_sectors, bh->b_data);
+	return 0;
 }
 
 /*
- * Write sectors to an ata device.
+ * Start a request (DMA transfer, completion is signaled by an interrupt).
  */
-static int ata_hd_write_sectors(struct ata_device *device, uint32_t sector, uint32_t nb_sectors, char *buf)
+static int ata_hd_start(struct ata_device *device, struct request *req)
 {
-	/* copy buffer */
-	memcpy(device->buf, buf, nb_sectors * ATA_SECTOR_SIZE);
+	int ret;
 
-	/* set transfert size */
-	device->prdt[0].transfert_size = nb_sectors * ATA_SECTOR_SIZE;
+	/* build prdt */
+	ret = ata_hd_build_prdt(device, req);
+	if (ret)
+		return ret;
 
 	/* prepare DMA transfert */
 	outb(device->bar4, 0);
 	outl(device->bar4 + 0x04, (uint32_t) device->prdt);
 	outb(device->bar4 + 0x02, inb(device->bar4 + 0x02) | 0x02 | 0x04);
 
-	/* select sector */
+	/* select sector (256 sectors = 0) */
 	outb(device->io_base + ATA_REG_CONTROL, 0x00);
-	outb(device->io_base + ATA_REG_HDDEVSEL, (device->drive == ATA_MASTER ? 0xE0 : 0xF0) | ((sector >> 24) & 0x0F));
+	outb(device->io_base + ATA_REG_HDDEVSEL, (device->drive == ATA_MASTER ? 0xE0 : 0xF0) | ((req->sector >> 24) & 0x0F));
 	outb(device->io_base + ATA_REG_FEATURES, 0x00);
-	outb(device->io_base + ATA_REG_SECCOUNT0, nb_sectors);
-	outb(device->io_base + ATA_REG_LBA0, (uint8_t) sector);
-	outb(device->io_base + ATA_REG_LBA1, (uint8_t) (sector >> 8));
-	outb(device->io_base + ATA_REG_LBA2, (uint8_t) (sector >> 16));
-
-	/* issue write DMA command */
-	outb(device->io_base + ATA_REG_COMMAND, ATA_CMD_WRITE_DMA);
-	outb(device->bar4, 0x1);
-
-	/* wait for completion */
-	ata_hd_wait(device);
+	outb(device->io_base + ATA_REG_SECCOUNT0, (uint8_t) req->nr_sectors);
+	outb(device->io_base + ATA_REG_LBA0, (uint8_t) req->sector);
+	outb(device->io_base + ATA_REG_LBA1, (uint8_t) (req->sector >> 8));
+	outb(device->io_base + ATA_REG_LBA2, (uint8_t) (req->sector >> 16));
+
+	/* issue DMA command */
+	if (req->cmd == WRITE) {
+		outb(device->io_base + ATA_REG_COMMAND, ATA_CMD_WRITE_DMA);
+		outb(device->bar4, 0x1);
+	} else {
+		outb(device->io_base + ATA_REG_COMMAND, ATA_CMD_READ_DMA);
+		outb(device->bar4, 0x8 | 0x1);
+	}
 
 	return 0;
 }
 
 /*
- * Write to an ata device.
+ * End a request (called on interrupt).
  */
-static int ata_hd_write(struct ata_device *device, struct buffer_head *bh, uint32_t start_sector)
+static int ata_hd_end(struct ata_device *device, struct request *req)
 {
-	uint32_t nb_sectors, sector;
+	int status, dstatus;
+
+	UNUSED(req);
 
-	/* compute nb sectors */
-	nb_sectors = bh->b_size / ATA_SECTOR_SIZE;
-	sector = start_sector + bh->b_block * bh->b_size / ATA_SECTOR_SIZE;
+	/* interrupt not raised by DMA controller */
+	status = inb(device->bar4 + 0x02);
+	if (!(status & 0x04))
+		return -EBUSY;
 
-	/* write sectors */
-	return ata_hd_write_sectors(device, sector, nb_sectors, bh->b_data);
+	/* stop DMA transfert and acknowledge interrupt */
+	outb(device->bar4, 0);
+	outb(device->bar4 + 0x02, status | 0x02 | 0x04);
+	dstatus = inb(device->io_base + ATA_REG_STATUS);
+
+	/* check errors */
+	if ((status & 0x02) || (dstatus & (ATA_SR_ERR | ATA_SR_DF)))
+		return -EIO;
+
+	return 0;
 }
 
 /*
@@ -139,26 +142,13 @@ int ata_hd_init(struct ata_device *device)
 	if (!ata_pci_device)
 		return -EINVAL;
 
-	/* allocate prdt */
-	device->prdt = kmalloc_align(sizeof(struct ata_prdt));
+	/* allocate prdt (page aligned : it can't cross a 64 KB boundary) */
+	device->prdt = kmalloc_align(sizeof(struct ata_prdt) * ATA_PRDT_ENTRIES);
 	if (!device->prdt)
 		return -ENOMEM;
 
-	/* allocate buffer */
-	device->buf = kmalloc_align(PAGE_SIZE);
-	if (!device->buf) {
-		kfree(device->prdt);
-		return -ENOMEM;
-	}
-
-	/* clear prdt and buffer */
-	memset(device->prdt, 0, sizeof(struct ata_prdt));
-	memset(device->buf, 0, PAGE_SIZE);
-
-	/* set prdt */
-	device->prdt[0].buffer_phys = (uint32_t) device->buf;
-	device->prdt[0].transfert_size = ATA_SECTOR_SIZE;
-	device->prdt[0].mark_end = 0x8000;
+	/* clear prdt */
+	memset(device->prdt, 0, sizeof(struct ata_prdt) * ATA_PRDT_ENTRIES);
 
 	/* activate pci */
 	cmd_reg = pci_read_field(ata_pci_device->address, PCI_CMD);
@@ -172,9 +162,14 @@ int ata_hd_init(struct ata_device *device)
 	if (device->bar4 & 0x00000001)
 		device->bar4 &= 0xFFFFFFFC;
 
+	/* secondary channel bus master registers follow primary ones */
+	if (device->bus == ATA_SECONDARY)
+		device->bar4 += 0x08;
+
 	/* set operations */
-	device->read = ata_hd_read;
-	device->write = ata_hd_write;
+	device->sector_size = ATA_SECTOR_SIZE;
+	device->start = ata_hd_start;
+	device->end = ata_hd_end;
 
 	return 0;
 }
@@ -0,0 +1,199 @@
+#include <drivers/block/blk_dev.h>
+#include <proc/sched.h>
+#include <x86/interrupt.h>
+#include <stderr.h>
+
+/* sort requests by disk then sector */
+#define IN_ORDER(dev1, sector1, dev2, sector2)	((dev1) < (dev2) || ((dev1) == (dev2) && (sector1) < (sector2)))
+
+/* requests pool */
+static struct request all_requests[NR_REQUEST];
+static LIST_HEAD(free_requests);
+static int requests_ready = 0;
+static struct wait_queue *wait_for_request = NULL;
+
+/*
+ * Init a request queue.
+ */
+void blk_init_queue(struct request_queue *q, void (*request_fn)(struct request_queue *), size_t max_size)
+{
+	int i;
+
+	/* init requests pool */
+	if (!requests_ready) {
+		for (i = 0; i < NR_REQUEST; i++)
+			list_add_tail(&all_requests[i].list, &free_requests);
+
+		requests_ready = 1;
+	}
+
+	/* init queue */
+	INIT_LIST_HEAD(&q->queue_head);
+	q->current_request = NULL;
+	q->last_dev = 0;
+	q->last_sector = 0;
+	q->max_size = max_size;
+	q->request_fn = request_fn;
+}
+
+/*
+ * Try to merge a buffer with a pending request (interrupts must be disabled).
+ */
+static int elv_merge(struct request_queue *q, int rw, struct buffer_head *bh, dev_t dev, uint32_t sector, uint32_t nr_sectors)
+{
+	struct list_head *pos;
+	struct request *req;
+
+	list_for_each(pos, &q->queue_head) {
+		req = list_entry(pos, struct request, list);
+
+		/* different request */
+		if (req->cmd != rw || req->dev != dev || req->size + bh->b_size > q->max_size)
+			continue;
+
+		/* buffer follows request */
+		if (req->sector + req->nr_sectors == sector) {
+			req->bhtail->b_reqnext = bh;
+			req->bhtail = bh;
+			req->nr_sectors += nr_sectors;
+			req->size += bh->b_size;
+			return 1;
+		}
+
+		/* buffer precedes request */
+		if (sector + nr_sectors == req->sector) {
+			bh->b_reqnext = req->bh;
+			req->bh = bh;
+			req->sector = sector;
+			req->nr_sectors += nr_sectors;
+			req->size += bh->b_size;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Add a request to a queue (interrupts must be disabled).
+ */
+static void elv_add_request(struct request_queue *q, struct request *req)
+{
+	struct list_head *pos;
+	struct request *tmp;
+
+	/* keep queue sorted */
+	list_for_each(pos, &q->queue_head) {
+		tmp = list_entry(pos, struct request, list);
+		if (IN_ORDER(req->dev, req->sector, tmp->dev, tmp->sector))
+			break;
+	}
+
+	list_add_tail(&req->list, pos);
+}
+
+/*
+ * Queue a buffer I/O (buffer must be locked, it will be unlocked on completion).
+ */
+int make_request(struct request_queue *q, int rw, struct buffer_head *bh, dev_t dev, uint32_t sector, uint32_t nr_sectors)
+{
+	struct request *req;
+	uint32_t flags;
+
+	bh->b_reqnext = NULL;
+
+	for (;;) {
+		irq_save(flags);
+
+		/* merge with a pending request */
+		if (elv_merge(q, rw, bh, dev, sector, nr_sectors))
+			break;
+
+		/* create a new request */
+		if (!list_empty(&free_requests)) {
+			req = list_first_entry(&free_requests, struct request, list);
+			list_del(&req->list);
+
+			req->cmd = rw;
+			req->dev = dev;
+			req->sector = sector;
+			req->nr_sectors = nr_sectors;
+			req->size = bh->b_size;
+			req->bh = bh;
+			req->bhtail = bh;
+			elv_add_request(q, req);
+			break;
+		}
+
+		/* no free request : wait for completions */
+		task_sleep(&wait_for_request);
+		irq_restore(flags);
+	}
+
+	/* device is idle : start requests */
+	if (!q->current_request)
+		q->request_fn(q);
+
+	irq_restore(flags);
+	return 0;
+}
+
+/*
+ * Get next request to serve (C-LOOK : serve requests in ascending order, then go back to the lowest one).
+ */
+struct request *blk_next_request(struct request_queue *q)
+{
+	struct list_head *pos;
+	struct request *req;
+
+	/* device busy or no pending request */
+	if (q->current_request || list_empty(&q->queue_head))
+		return NULL;
+
+	/* find first request after elevator position */
+	list_for_each(pos, &q->queue_head) {
+		req = list_entry(pos, struct request, list);
+		if (!IN_ORDER(req->dev, req->sector, q->last_dev, q->last_sector))
+			goto found;
+	}
+
+	/* else go back to first request */
+	req = list_first_entry(&q->queue_head, struct request, list);
+found:
+	list_del(&req->list);
+	q->current_request = req;
+	q->last_dev = req->dev;
+	q->last_sector = req->sector + req->nr_sectors;
+
+	return req;
+}
+
+/*
+ * End current request (unlock its buffers and wake up waiting tasks).
+ * A failed write keeps buffer data valid and dirties it again, so it will be retried.
+ */
+void end_request(struct request_queue *q, int uptodate)
+{
+	struct request *req = q->current_request;
+	struct buffer_head *bh, *next;
+
+	if (!req)
+		return;
+
+	/* update and unlock buffers */
+	for (bh = req->bh; bh != NULL; bh = next) {
+		next = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		bh->b_ioerror = !uptodate;
+		if (req->cmd == READ)
+			bh->b_uptodate = uptodate;
+		else if (!uptodate)
+			mark_buffer_dirty(bh);
+		unlock_buffer(bh);
+	}
+
+	/* release request */
+	q->current_request = NULL;
+	list_add(&req->list, &free_requests);
+	task_wakeup_all(&wait_for_request);
+}
@@ -17,6 +17,9 @@
 volatile time_t jiffies = 0;
 struct kernel_timeval xtimes = { 0, 0 };
 
+/* CPU frequency (0 if Time Stamp Counter calibration failed) */
+uint32_t cpu_khz = 0;
+
 /* Time Stamp Counter variables */
 static uint32_t tsc_quotient;
 static uint32_t last_tsc_low;
@@ -135,7 +138,7 @@ static void pit_handler(struct registers *regs)
  */
 void init_pit()
 {
-	uint32_t cpu_khz, divisor, eax, edx;
+	uint32_t divisor, eax, edx;
 
 	/* get CPU frequency */
 	tsc_quotient = calibrate_tsc();
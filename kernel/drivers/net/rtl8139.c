@@ -28,7 +28,7 @@ static void rtl8139_send_packet(struct sk_buff *skb)
 	memcpy(tx_buffer[tx_cur], skb->head, skb->len);
 
 	/* put packet on device */
-	outl(rtl8139_net_dev->io_base + 0x20 + tx_cur * 4, (uint32_t) (tx_buffer[tx_cur]));
+	outl(rtl8139_net_dev->io_base + 0x20 + tx_cur * 4, V2P((uint32_t) tx_buffer[tx_cur]));
 	outl(rtl8139_net_dev->io_base + 0x10 + tx_cur * 4, skb->size);
 
 	/* update tx buffer index */
@@ -149,24 +149,24 @@ int init_rtl8139(uint8_t *ip_addr, uint8_t *ip_netmask, uint8_t *ip_route)
 	while (inb(io_base + 0x37) & 0x10);
 
 	/* allocate receive buffer */
-	rx_buffer = kmalloc_align(RX_BUFFER_SIZE);
+	rx_buffer = get_free_pages(get_order(RX_BUFFER_SIZE));
 	if (!rx_buffer)
 		return -ENOMEM;
 
 	/* allocate transmit buffers */
 	for (i = 0; i < 4; i++) {
-		tx_buffer[i] = kmalloc_align(PAGE_SIZE);
+		tx_buffer[i] = get_free_page();
 		if (!tx_buffer[i]) {
 			while (--i >= 0)
-				kfree(tx_buffer[i]);
-			kfree(rx_buffer);
+				free_page(tx_buffer[i]);
+			free_pages(&page_table[MAP_NR((uint32_t) rx_buffer)], get_order(RX_BUFFER_SIZE));
 			return -ENOMEM;
 		}
 	}
 
 	/* memzero buffer and set physical address on chip */
 	memset(rx_buffer, 0, RX_BUFFER_SIZE);
-	outl(io_base + 0x30, (uint32_t) rx_buffer);
+	outl(io_base + 0x30, V2P((uint32_t) rx_buffer));
 
 	/* set Interrupt Mask Register (only accept Transmit OK and Receive OK interrupts) */
 	outw(io_base + 0x3C, 0x0005);
@@ -99,7 +99,7 @@ int generic_block_write(struct file *filp, const char *buf, int count)
 		memcpy(bh->b_data + pos, buf, nb_chars);
 
 		/* release block */
-		bh->b_dirt = 1;
+		mark_buffer_dirty(bh);
 		brelse(bh);
 
 		/* update sizes */
@@ -112,16 +112,55 @@ int generic_block_write(struct file *filp, const char *buf, int count)
 }
 
 /*
- * Read a block.
+ * Queue a block I/O (buffer is locked until completion).
  */
-int block_read(struct buffer_head *bh)
+int ll_rw_block(int rw, struct buffer_head *bh)
 {
+	int ret;
+
+	/* buffer already under I/O : read will be done, write must wait */
+	if (bh->b_lock) {
+		if (rw == READ)
+			return 0;
+
+		wait_on_buffer(bh);
+	}
+
+	/* lock buffer */
+	bh->b_lock = 1;
+
 	switch (major(bh->b_dev)) {
 		case DEV_ATA_MAJOR:
-			return ata_read(bh);
+			ret = rw == READ ? ata_read(bh) : ata_write(bh);
+			break;
 		default:
-			return -EINVAL;
+			ret = -EINVAL;
+			break;
 	}
+
+	/* unlock buffer on error */
+	if (ret)
+		unlock_buffer(bh);
+
+	return ret;
+}
+
+/*
+ * Read a block.
+ */
+int block_read(struct buffer_head *bh)
+{
+	int ret;
+
+	/* queue request */
+	ret = ll_rw_block(READ, bh);
+	if (ret)
+		return ret;
+
+	/* wait for completion */
+	wait_on_buffer(bh);
+
+	return bh->b_uptodate ? 0 : -EIO;
 }
 
 /*
@@ -129,10 +168,15 @@ int block_read(struct buffer_head *bh)
  */
 int block_write(struct buffer_head *bh)
 {
-	switch (major(bh->b_dev)) {
-		case DEV_ATA_MAJOR:
-			return ata_write(bh);
-		default:
-			return -EINVAL;
-	}
+	int ret;
+
+	/* queue request */
+	ret = ll_rw_block(WRITE, bh);
+	if (ret)
+		return ret;
+
+	/* wait for completion */
+	wait_on_buffer(bh);
+
+	return bh->b_ioerror ? -EIO : 0;
 }
@@ -6,12 +6,17 @@
 #include <string.h>
 #include <stderr.h>
 #include <stdio.h>
+#include <fcntl.h>
 #include <time.h>
 #include <dev.h>
 
 #define NR_SIZES			4
 #define BUFSIZE_INDEX(size)		(buffersize_index[(size) >> 9])
 
+#define BDFLUSH_FREQ_MS			5000
+#define DIRTY_EXPIRE_MS			30000
+#define DIRTY_RATIO			40
+
 /* global buffer table */
 static int nr_buffer = 0;
 static int buffer_htable_bits = 0;
@@ -23,6 +28,14 @@ static char buffersize_index[9] = { -1, 0, 1, -1, 2, -1, -1, -1, 3 };
 static struct list_head unused_list;
 static struct list_head free_list[NR_SIZES];
 
+/* dirty buffers */
+static uint32_t nr_dirty = 0;
+static uint32_t dirty_limit = 0;
+
+/* buffers flush daemon */
+static struct task *bdflush_task = NULL;
+static struct wait_queue *bdflush_wait = NULL;
+
 /* block size of devices */
 size_t *blocksize_size[MAX_BLKDEV] = { NULL, NULL };
 
@@ -57,6 +70,66 @@ void set_blocksize(dev_t dev, size_t blocksize)
 	blocksize_size[major(dev)][minor(dev)] = blocksize;
 }
 
+/*
+ * Mark a buffer dirty (it will be written back by flush daemon).
+ */
+void mark_buffer_dirty(struct buffer_head *bh)
+{
+	/* already dirty */
+	if (bh->b_dirt)
+		return;
+
+	bh->b_dirt = 1;
+	bh->b_dirtytime = jiffies;
+	nr_dirty++;
+
+	/* too many dirty buffers : wake up flush daemon */
+	if (nr_dirty > dirty_limit && bdflush_task && bdflush_task->state == TASK_SLEEPING)
+		task_wakeup(&bdflush_wait);
+}
+
+/*
+ * Mark a buffer clean.
+ */
+static void clear_buffer_dirty(struct buffer_head *bh)
+{
+	if (!bh->b_dirt)
+		return;
+
+	bh->b_dirt = 0;
+	nr_dirty--;
+}
+
+/*
+ * Wait for end of I/O on a buffer.
+ */
+void wait_on_buffer(struct buffer_head *bh)
+{
+	uint32_t flags;
+
+	for (;;) {
+		irq_save(flags);
+
+		/* I/O done */
+		if (!bh->b_lock)
+			break;
+
+		task_sleep(&bh->b_wait);
+		irq_restore(flags);
+	}
+
+	irq_restore(flags);
+}
+
+/*
+ * Unlock a buffer (called on I/O completion).
+ */
+void unlock_buffer(struct buffer_head *bh)
+{
+	bh->b_lock = 0;
+	task_wakeup_all(&bh->b_wait);
+}
+
 /*
  * Get an unused buffer.
  */
@@ -160,8 +233,9 @@ static int refill_freelist(size_t blocksize)
 		tmp = tmp->b_this_page;
 	} while (tmp != bh);
 
-	/* set page buffers */
+	/* set page buffers and add page to LRU lists */
 	page_table[MAP_NR((uint32_t) page)].buffers = bh;
+	lru_cache_add(&page_table[MAP_NR((uint32_t) page)]);
 
 	return 0;
 }
@@ -179,6 +253,7 @@ static struct buffer_head *find_buffer(dev_t dev, uint32_t block, size_t blocksi
 	while (node) {
 		bh = htable_entry(node, struct buffer_head, b_htable);
 		if (bh->b_block == block && bh->b_dev == dev && bh->b_size == blocksize) {
+			mark_page_accessed(&page_table[MAP_NR((uint32_t) bh->b_data)]);
 			bh->b_ref++;
 			return bh;
 		}
@@ -189,6 +264,16 @@ static struct buffer_head *find_buffer(dev_t dev, uint32_t block, size_t blocksi
 	return NULL;
 }
 
+/*
+ * Remove a buffer from hash table.
+ */
+static void unhash_buffer(struct buffer_head *bh)
+{
+	htable_delete(&bh->b_htable);
+	bh->b_htable.next = NULL;
+	bh->b_htable.pprev = NULL;
+}
+
 /*
  * Get a buffer (from cache or create one).
  */
@@ -265,37 +350,33 @@ int bwrite(struct buffer_head *bh)
 	if (ret)
 		return ret;
 
-	bh->b_dirt = 0;
+	clear_buffer_dirty(bh);
 	return ret;
 }
 
 /*
- * Release a buffer.
+ * Release a buffer (dirty buffers are written back later by flush daemon).
  */
 void brelse(struct buffer_head *bh)
 {
 	if (!bh)
 		return;
 
-	/* write dirty buffer */
-	if (bh->b_dirt)
-		bwrite(bh);
-
 	/* update inode reference count */
 	bh->b_ref--;
 }
 
 /*
- * Try to free a buffer.
+ * Try to free a buffer page (returns 1 if the page has been freed).
  */
-void try_to_free_buffer(struct buffer_head *bh)
+int try_to_free_buffer(struct buffer_head *bh)
 {
 	struct buffer_head *tmp, *tmp1;
 	uint32_t page;
 
 	/* already freed */
 	if (!bh->b_this_page)
-		return;
+		return 0;
 
 	/* get page address */
 	page = (uint32_t) bh->b_data & PAGE_MASK;
@@ -304,8 +385,8 @@ void try_to_free_buffer(struct buffer_head *bh)
 	tmp = bh;
 	do {
 		/* used buffer */
-		if (tmp->b_ref || tmp->b_dirt)
-			return;
+		if (tmp->b_ref || tmp->b_dirt || tmp->b_lock)
+			return 0;
 
 		/* go to next buffer in page */
 		tmp = tmp->b_this_page;
@@ -317,8 +398,10 @@ void try_to_free_buffer(struct buffer_head *bh)
 		/* save next buffer */
 		tmp1 = tmp->b_this_page;
 
-		/* remove it from lists */
+		/* remove it from lists (never used buffers are still on free list) */
 		htable_delete(&tmp->b_htable);
+		if (tmp->b_list.next)
+			list_del(&tmp->b_list);
 		put_unused_buffer(tmp);
 
 		/* go to next buffer in page */
@@ -327,40 +410,102 @@ void try_to_free_buffer(struct buffer_head *bh)
 
 	/* free page */
 	free_page((void *) page);
+	return 1;
 }
 
 /*
  * Write all dirty buffers on disk.
  */
-void bsync()
+int bsync()
 {
-	int i;
+	return bsync_dev(0);
+}
 
-	/* write all dirty buffers */
+/*
+ * Write dirty buffers of a device (all devices if dev = 0) dirtied before a time (returns number of errors).
+ */
+static int flush_buffers(dev_t dev, time_t dirtied_before)
+{
+	struct buffer_head *bh;
+	int i, ret = 0;
+
+	/* queue dirty buffers (elevator will sort and merge them) */
 	for (i = 0; i < nr_buffer; i++) {
-		if (buffer_table[i].b_dirt && bwrite(&buffer_table[i])) {
-			printf("Can't write block %d on disk\n", buffer_table[i].b_block);
-			panic("Disk error");
+		bh = &buffer_table[i];
+		if ((dev && bh->b_dev != dev) || !bh->b_dirt || bh->b_dirtytime > dirtied_before)
+			continue;
+
+		/* clear dirty flag before I/O so that new writes dirty it again (failed writes are dirtied again too) */
+		clear_buffer_dirty(bh);
+		if (ll_rw_block(WRITE, bh)) {
+			printf("Can't write block %d on disk\n", bh->b_block);
+			mark_buffer_dirty(bh);
+			ret++;
+			continue;
 		}
+
+		bh->b_flush = 1;
 	}
+
+	/* wait for completion */
+	for (i = 0; i < nr_buffer; i++) {
+		bh = &buffer_table[i];
+		if (!bh->b_flush)
+			continue;
+
+		wait_on_buffer(bh);
+		bh->b_flush = 0;
+
+		if (bh->b_ioerror) {
+			printf("Can't write block %d on disk\n", bh->b_block);
+			ret++;
+		}
+	}
+
+	return ret;
 }
 
 /*
- * Write all dirty buffers on disk.
+ * Write all dirty buffers of a device on disk (all devices if dev = 0).
  */
-void bsync_dev(dev_t dev)
+int bsync_dev(dev_t dev)
 {
-	int i;
+	return flush_buffers(dev, jiffies) ? -EIO : 0;
+}
 
-	/* write all dirty buffers */
-	for (i = 0; i < nr_buffer; i++) {
-		if (buffer_table[i].b_dev == dev && buffer_table[i].b_dirt && bwrite(&buffer_table[i])) {
-			printf("Can't write block %d on disk\n", buffer_table[i].b_block);
-			panic("Disk error");
-		}
+/*
+ * Buffers flush daemon.
+ */
+static void bdflush(void *arg)
+{
+	UNUSED(arg);
+
+	for (;;) {
+		/* write old dirty buffers (or all of them if there are too many) */
+		if (nr_dirty > dirty_limit)
+			flush_buffers(0, jiffies);
+		else if (nr_dirty)
+			flush_buffers(0, jiffies - ms_to_jiffies(DIRTY_EXPIRE_MS));
+
+		/* wait for too many dirty buffers (or check periodically) */
+		current_task->timeout = jiffies + ms_to_jiffies(BDFLUSH_FREQ_MS);
+		task_sleep(&bdflush_wait);
+		current_task->timeout = 0;
 	}
 }
 
+/*
+ * Init buffers flush daemon.
+ */
+int init_bdflush()
+{
+	bdflush_task = create_kernel_thread(bdflush, NULL);
+	if (!bdflush_task)
+		return -ENOMEM;
+
+	return 0;
+}
+
 /*
  * Sync system call.
  */
@@ -373,16 +518,50 @@ int sys_sync()
 }
 
 /*
- * Fsync system call (don't do anything because all block buffers should be clean).
+ * Write a file on disk (inode is written too, unless datasync is set).
  */
-int sys_fsync(int fd)
+static int do_fsync(int fd, int datasync)
 {
-	UNUSED(fd);
+	struct inode *inode;
+
+	/* check fd */
+	if (fd < 0 || fd >= NR_OPEN || !current_task->files->filp[fd])
+		return -EBADF;
+
+	/* write inode */
+	inode = current_task->files->filp[fd]->f_inode;
+	if (!datasync && inode->i_dirt && inode->i_sb && inode->i_sb->s_op && inode->i_sb->s_op->write_inode) {
+		inode->i_sb->s_op->write_inode(inode);
+		inode->i_dirt = 0;
+	}
+
+	/* write device buffers (block devices or file system device) */
+	if (S_ISBLK(inode->i_mode))
+		return flush_buffers(inode->i_rdev, jiffies) ? -EIO : 0;
+	if (inode->i_sb && inode->i_sb->s_dev)
+		return flush_buffers(inode->i_sb->s_dev, jiffies) ? -EIO : 0;
+
 	return 0;
 }
 
 /*
- * Read a page.
+ * Fsync system call.
+ */
+int sys_fsync(int fd)
+{
+	return do_fsync(fd, 0);
+}
+
+/*
+ * Fdatasync system call.
+ */
+int sys_fdatasync(int fd)
+{
+	return do_fsync(fd, 1);
+}
+
+/*
+ * Start reading a page (page stays locked until wait_on_page() collects its buffers).
  */
 int generic_readpage(struct inode *inode, struct page *page)
 {
@@ -401,84 +580,314 @@ int generic_readpage(struct inode *inode, struct page *page)
 	if (!bh)
 		return -ENOMEM;
 
-	/* read block by block */
-	for (i = 0, next = bh; i < nr; i++, block++) {
+	/* attach buffers to page until reads complete */
+	page->buffers = bh;
+	page->locked = 1;
+
+	/* queue all blocks (so that contiguous blocks are merged in a single request) */
+	for (i = 0, next = bh; i < nr; i++, block++, next = next->b_this_page) {
 		/* set block buffer */
 		next->b_dev = sb->s_dev;
 		next->b_block = inode->i_op->bmap(inode, block);
 		next->b_uptodate = 1;
 
+		/* hole : zero block */
+		if (!next->b_block) {
+			memset(next->b_data, 0, sb->s_blocksize);
+			continue;
+		}
+
 		/* check if buffer is already hashed */
 		tmp = find_buffer(sb->s_dev, next->b_block, sb->s_blocksize);
 		if (tmp) {
 			/* read it from disk if needed */
-			if (!tmp->b_uptodate)
-				block_read(tmp);
+			if (!tmp->b_uptodate && block_read(tmp))
+				next->b_uptodate = 0;
 
 			/* copy data to user address space */
 			memcpy(next->b_data, tmp->b_data, sb->s_blocksize);
 
 			/* release buffer */
 			brelse(tmp);
-			goto next;
+			continue;
 		}
 
-		/* read buffer on disk */
-		block_read(next);
- next:
-		/* clear temporary buffer */
-		tmp = next->b_this_page;
-		put_unused_buffer(next);
-		next = tmp;
+		/* read buffer on disk (completion is checked by wait_on_page) */
+		if (ll_rw_block(READ, next))
+			next->b_uptodate = 0;
 	}
 
 	return 0;
 }
 
 /*
- * Init buffers.
+ * Forget a cached block (a page cache buffer holds its data now).
  */
-int binit()
+static void forget_buffer(dev_t dev, uint32_t block, size_t blocksize)
 {
-	void *addr;
-	int nr, i;
+	struct buffer_head *bh;
 
-	/* number of buffers = number of pages / 4 */
-	nr_buffer = 1 << blksize_bits(nr_pages / 4);
-	buffer_htable_bits = blksize_bits(nr_buffer);
+	bh = find_buffer(dev, block, blocksize);
+	if (!bh)
+		return;
+
+	/* stale copy must never be written back */
+	wait_on_buffer(bh);
+	clear_buffer_dirty(bh);
+	bh->b_uptodate = 0;
+	unhash_buffer(bh);
+	brelse(bh);
+}
+
+/*
+ * Mark a page cache range dirty (blocks are allocated and page buffers are written back by flush daemon).
+ */
+int generic_commit_write(struct inode *inode, struct page *page, uint32_t offset, size_t count)
+{
+	struct super_block *sb = inode->i_sb;
+	struct buffer_head *bh, *tmp;
+	uint32_t start, block;
+	int block_nr;
 
-	/* allocate buffers */
-	nr = 1 + nr_buffer * sizeof(struct buffer_head) / PAGE_SIZE;
-	for (i = 0; i < nr; i++) {
-		/* get a free page */
-		addr = get_free_page();
-		if (!addr)
+	/* attach buffers to page (page is up to date) */
+	if (!page->buffers) {
+		bh = create_buffers((void *) PAGE_ADDRESS(page), sb->s_blocksize);
+		if (!bh)
 			return -ENOMEM;
 
-		/* reset page */
-		memset(addr, 0, PAGE_SIZE);
+		tmp = bh;
+		do {
+			tmp->b_dev = sb->s_dev;
+			tmp->b_uptodate = 1;
+			tmp = tmp->b_this_page;
+		} while (tmp != bh);
 
-		/* set buffer table */
-		if (i == 0)
-			buffer_table = addr;
+		page->buffers = bh;
 	}
 
-	/* allocate buffers hash table */
-	nr = 1 + nr_buffer * sizeof(struct htable_link *) / PAGE_SIZE;
-	for (i = 0; i < nr; i++) {
-		/* get a free page */
-		addr = get_free_page();
-		if (!addr)
-			return -ENOMEM;
+	/* map and dirty written blocks */
+	block = page->offset >> sb->s_blocksize_bits;
+	bh = page->buffers;
+	start = 0;
+	do {
+		if (start < offset + count && start + bh->b_size > offset) {
+			/* map block (allocate it if needed) */
+			if (!bh->b_block) {
+				block_nr = inode->i_op->get_block(inode, block);
+				if (!block_nr)
+					return -ENOSPC;
+
+				forget_buffer(sb->s_dev, block_nr, sb->s_blocksize);
+				bh->b_block = block_nr;
+				htable_insert(buffer_htable, &bh->b_htable, block_nr, buffer_htable_bits);
+			}
+
+			/* wait for pending write before redirtying */
+			wait_on_buffer(bh);
+			mark_buffer_dirty(bh);
+		}
+
+		start += bh->b_size;
+		block++;
+		bh = bh->b_this_page;
+	} while (bh != page->buffers);
 
-		/* reset page */
-		memset(addr, 0, PAGE_SIZE);
+	return 0;
+}
 
-		/* set buffer hash table */
-		if (i == 0)
-			buffer_htable = addr;
+/*
+ * Release buffers of a page cache page.
+ */
+static void free_page_buffers(struct page *page)
+{
+	struct buffer_head *bh, *next;
+
+	bh = page->buffers;
+	do {
+		next = bh->b_this_page;
+		unhash_buffer(bh);
+		put_unused_buffer(bh);
+		bh = next;
+	} while (bh != page->buffers);
+
+	page->buffers = NULL;
+	page->locked = 0;
+}
+
+/*
+ * Wait for end of reads on a page and release its buffers (returns -EIO on read error).
+ */
+int wait_on_page(struct page *page)
+{
+	struct buffer_head *bh;
+	int ret = 0;
+
+	while (page->locked) {
+		/* find a pending read */
+		bh = page->buffers;
+		while (!bh->b_lock && bh->b_this_page != page->buffers)
+			bh = bh->b_this_page;
+
+		/* wait for it (buffers may be released meanwhile : rescan page) */
+		if (bh->b_lock) {
+			wait_on_buffer(bh);
+			continue;
+		}
+
+		/* all reads done : check errors and release buffers */
+		do {
+			if (!bh->b_uptodate)
+				ret = -EIO;
+
+			bh = bh->b_this_page;
+		} while (bh != page->buffers);
+
+		free_page_buffers(page);
 	}
 
+	return ret;
+}
+
+/*
+ * Try to release buffers of a page cache page (returns 1 if page has no more buffers).
+ */
+int try_to_free_page_buffers(struct page *page)
+{
+	struct buffer_head *bh;
+
+	/* no buffers */
+	if (!page->buffers)
+		return 1;
+
+	/* check if all page buffers can be freed */
+	bh = page->buffers;
+	do {
+		if (bh->b_ref || bh->b_dirt || bh->b_lock)
+			return 0;
+
+		bh = bh->b_this_page;
+	} while (bh != page->buffers);
+
+	free_page_buffers(page);
+	return 1;
+}
+
+/*
+ * Discard page cache buffers from an offset (truncated blocks must never be written back).
+ */
+void discard_page_buffers(struct page *page, uint32_t offset)
+{
+	struct buffer_head *bh;
+	uint32_t start;
+
+	/* no buffers */
+	if (!page->buffers)
+		return;
+
+	bh = page->buffers;
+	start = 0;
+	do {
+		if (start + bh->b_size > offset) {
+			wait_on_buffer(bh);
+
+			/* truncated block : unmap it */
+			if (start >= offset) {
+				clear_buffer_dirty(bh);
+				unhash_buffer(bh);
+				bh->b_block = 0;
+			} else if (bh->b_block) {
+				/* partially truncated block : write zeroed tail */
+				mark_buffer_dirty(bh);
+			}
+		}
+
+		start += bh->b_size;
+		bh = bh->b_this_page;
+	} while (bh != page->buffers);
+
+	/* whole page truncated : release buffers */
+	if (!offset)
+		free_page_buffers(page);
+}
+
+/*
+ * Write dirty page cache buffers of an inode (returns number of errors).
+ */
+int sync_inode_pages(struct inode *inode)
+{
+	struct list_head *pos;
+	struct buffer_head *bh;
+	struct page *page;
+	int ret = 0;
+
+	/* queue dirty buffers */
+	list_for_each(pos, &inode->i_pages) {
+		page = list_entry(pos, struct page, list);
+		if (!page->buffers || page->locked)
+			continue;
+
+		bh = page->buffers;
+		do {
+			if (bh->b_dirt) {
+				clear_buffer_dirty(bh);
+				if (ll_rw_block(WRITE, bh))
+					ret++;
+			}
+
+			bh = bh->b_this_page;
+		} while (bh != page->buffers);
+	}
+
+	/* wait for completion */
+	list_for_each(pos, &inode->i_pages) {
+		page = list_entry(pos, struct page, list);
+		if (!page->buffers || page->locked)
+			continue;
+
+		bh = page->buffers;
+		do {
+			wait_on_buffer(bh);
+			if (bh->b_block && bh->b_ioerror)
+				ret++;
+
+			bh = bh->b_this_page;
+		} while (bh != page->buffers);
+	}
+
+	if (ret)
+		printf("Can't write inode %d pages on disk\n", inode->i_ino);
+
+	return ret;
+}
+
+/*
+ * Init buffers.
+ */
+int binit()
+{
+	size_t size;
+	int i;
+
+	/* number of buffers = number of pages / 4 */
+	nr_buffer = 1 << blksize_bits(nr_pages / 4);
+	buffer_htable_bits = blksize_bits(nr_buffer);
+
+	/* flush daemon writes all dirty buffers above this limit */
+	dirty_limit = nr_buffer * DIRTY_RATIO / 100;
+
+	/* allocate buffers (one contiguous block) */
+	size = nr_buffer * sizeof(struct buffer_head);
+	buffer_table = (struct buffer_head *) get_free_pages(get_order(size));
+	if (!buffer_table)
+		return -ENOMEM;
+	memset(buffer_table, 0, size);
+
+	/* allocate buffers hash table (one contiguous block) */
+	size = (1 << buffer_htable_bits) * sizeof(struct htable_link *);
+	buffer_htable = (struct htable_link **) get_free_pages(get_order(size));
+	if (!buffer_htable)
+		return -ENOMEM;
+
 	/* init buffers list */
 	INIT_LIST_HEAD(&unused_list);
 	for (i = 0; i < NR_SIZES; i++)
@@ -7,8 +7,8 @@
  * Ext2 file operations.
  */
 struct file_operations ext2_file_fops = {
-	.read		= ext2_file_read,
-	.write		= ext2_file_write,
+	.read		= generic_file_read,
+	.write		= generic_file_write,
 	.mmap		= generic_file_mmap,
 };
 
@@ -26,6 +26,7 @@ struct inode_operations ext2_file_iops = {
 	.fops		= &ext2_file_fops,
 	.truncate	= ext2_truncate,
 	.bmap		= ext2_bmap,
+	.get_block	= ext2_get_block,
 	.readpage	= generic_readpage,
 };
 
@@ -215,7 +216,7 @@ int ext2_write_inode(struct inode *inode)
 		raw_inode->i_block[i] = ext2_inode->i_data[i];
 
 	/* release block buffer */
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	brelse(bh);
 
 	return 0;
@@ -309,7 +310,7 @@ static struct buffer_head *ext2_block_getblk(struct inode *inode, struct buffer_
 		i = ext2_new_block(inode, goal);
 		if (i) {
 			((uint32_t *) bh->b_data)[block_block] = i;
-			bh->b_dirt = 1;
+			mark_buffer_dirty(bh);
 		}
 	}
 
@@ -445,3 +446,26 @@ int ext2_bmap(struct inode *inode, int block)
 		return 0;
 	return block_bmap(bread(sb->s_dev, i, sb->s_blocksize), block & (addr_per_block - 1));
 }
+
+/*
+ * Get a block number (allocate block if needed).
+ */
+int ext2_get_block(struct inode *inode, int block)
+{
+	struct buffer_head *bh;
+	int ret;
+
+	/* block already allocated */
+	ret = ext2_bmap(inode, block);
+	if (ret)
+		return ret;
+
+	/* allocate block */
+	bh = ext2_bread(inode, block, 1);
+	if (!bh)
+		return 0;
+
+	ret = bh->b_block;
+	brelse(bh);
+	return ret;
+}
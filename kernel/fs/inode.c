@@ -28,7 +28,8 @@ void insert_inode_hash(struct inode *inode)
  */
 void clear_inode(struct inode *inode)
 {
-	/* truncate inode pages */
+	/* write dirty pages and truncate inode pages */
+	sync_inode_pages(inode);
 	truncate_inode_pages(inode, 0);
 
 	/* clear inode */
@@ -171,8 +172,11 @@ void iput(struct inode *inode)
 	/* update inode reference count */
 	inode->i_ref--;
 
-	/* put inode */
+	/* put inode (pages of a deleted inode are dropped before its blocks are freed) */
 	if (inode->i_sb && inode->i_sb->s_op->put_inode) {
+		if (!inode->i_ref && !inode->i_nlinks)
+			truncate_inode_pages(inode, 0);
+
 		inode->i_sb->s_op->put_inode(inode);
 		if (!inode->i_nlinks)
 			return;
@@ -187,42 +191,23 @@ void iput(struct inode *inode)
  */
 int iinit()
 {
-	void *addr;
-	int nr, i;
+	size_t size;
+	int i;
 
 	inode_htable_bits = blksize_bits(NR_INODE);
 
-	/* allocate inodes */
-	nr = 1 + NR_INODE * sizeof(struct inode) / PAGE_SIZE;
-	for (i = 0; i < nr; i++) {
-		/* get a free page */
-		addr = get_free_page();
-		if (!addr)
-			return -ENOMEM;
-
-		/* reset page */
-		memset(addr, 0, PAGE_SIZE);
-
-		/* set inode table */
-		if (i == 0)
-			inode_table = addr;
-	}
-
-	/* allocate inode hash table */
-	nr = 1 + NR_INODE * sizeof(struct htable_link *) / PAGE_SIZE;
-	for (i = 0; i < nr; i++) {
-		/* get a free page */
-		addr = get_free_page();
-		if (!addr)
-			return -ENOMEM;
-
-		/* reset page */
-		memset(addr, 0, PAGE_SIZE);
-
-		/* set inode hash table */
-		if (i == 0)
-			inode_htable = addr;
-	}
+	/* allocate inodes (one contiguous block) */
+	size = NR_INODE * sizeof(struct inode);
+	inode_table = (struct inode *) get_free_pages(get_order(size));
+	if (!inode_table)
+		return -ENOMEM;
+	memset(inode_table, 0, size);
+
+	/* allocate inode hash table (one contiguous block) */
+	size = (1 << inode_htable_bits) * sizeof(struct htable_link *);
+	inode_htable = (struct htable_link **) get_free_pages(get_order(size));
+	if (!inode_htable)
+		return -ENOMEM;
 
 	/* add all inodes to free list */
 	INIT_LIST_HEAD(&free_inodes);
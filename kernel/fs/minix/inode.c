@@ -19,8 +19,8 @@ struct file_operations minix_dir_fops = {
  * File operations.
  */
 struct file_operations minix_file_fops = {
-	.read			= minix_file_read,
-	.write			= minix_file_write,
+	.read			= generic_file_read,
+	.write			= generic_file_write,
 	.mmap			= generic_file_mmap,
 };
 
@@ -39,6 +39,7 @@ struct inode_operations minix_file_iops = {
 	.fops			= &minix_file_fops,
 	.truncate		= minix_truncate,
 	.bmap			= minix_bmap,
+	.get_block		= minix_get_block,
 	.readpage		= generic_readpage,
 };
 
@@ -163,7 +164,7 @@ int minix_write_inode(struct inode *inode)
 			raw_inode->i_zone[i] = inode->u.minix_i.i_zone[i];
 
 	/* write inode block */
-	bh->b_dirt = 1;
+	mark_buffer_dirty(bh);
 	brelse(bh);
 
 	return 0;
@@ -220,7 +221,7 @@ static struct buffer_head *block_getblk(struct inode *inode, struct buffer_head
 	if (create && !i) {
 		if ((i = minix_new_block(inode->i_sb))) {
 			((uint32_t *) (bh->b_data))[block] = i;
-			bh->b_dirt = 1;
+			mark_buffer_dirty(bh);
 		}
 	}
 
@@ -346,3 +347,26 @@ int minix_bmap(struct inode *inode, int block)
 		return 0;
 	return block_bmap(bread(sb->s_dev, i, sb->s_blocksize), block & 255);
 }
+
+/*
+ * Get a block number (allocate block if needed).
+ */
+int minix_get_block(struct inode *inode, int block)
+{
+	struct buffer_head *bh;
+	int ret;
+
+	/* block already allocated */
+	ret = minix_bmap(inode, block);
+	if (ret)
+		return ret;
+
+	/* allocate block */
+	bh = minix_getblk(inode, block, 1);
+	if (!bh)
+		return 0;
+
+	ret = bh->b_block;
+	brelse(bh);
+	return ret;
+}
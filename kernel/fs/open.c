@@ -24,7 +24,10 @@ struct file *get_empty_filp()
 	if (i >= NR_FILE)
 		return NULL;
 
+	/* reset file (readahead state starts at beginning of file) */
 	filp_table[i].f_ref = 1;
+	memset(&filp_table[i].f_ra, 0, sizeof(struct file_ra_state));
+
 	return &filp_table[i];
 }
 
@@ -0,0 +1,108 @@
+#include <fs/fs.h>
+#include <mm/mm.h>
+#include <lib/strbench.h>
+#include <string.h>
+#include <stdio.h>
+#include <stderr.h>
+
+/*
+ * Read a benchmark file (benchmark runs once per open file, on first read : later reads get the same output).
+ */
+static int proc_bench_read(struct file *filp, char *buf, int count, int (*get_bench)(char *, int))
+{
+	char *tmp_buf = filp->f_private;
+	size_t len;
+
+	/* run benchmark on first read (or when reading again from start) */
+	if (!filp->f_pos) {
+		if (!tmp_buf) {
+			tmp_buf = (char *) get_free_page();
+			if (!tmp_buf)
+				return -ENOMEM;
+
+			filp->f_private = tmp_buf;
+		}
+
+		/* keep output as a string (its length is needed by later reads) */
+		len = get_bench(tmp_buf, PAGE_SIZE - 1);
+		tmp_buf[len] = 0;
+	}
+
+	/* no output */
+	if (!tmp_buf)
+		return 0;
+
+	/* file position after end */
+	len = strlen(tmp_buf);
+	if (filp->f_pos >= len)
+		return 0;
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+	return count;
+}
+
+/*
+ * Release benchmark output.
+ */
+static int proc_bench_close(struct file *filp)
+{
+	if (filp->f_private) {
+		free_page(filp->f_private);
+		filp->f_private = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * Run string functions benchmark.
+ */
+static int proc_strbench_read(struct file *filp, char *buf, int count)
+{
+	return proc_bench_read(filp, buf, count, get_strbench);
+}
+
+/*
+ * Run TLB reach benchmark.
+ */
+static int proc_tlbbench_read(struct file *filp, char *buf, int count)
+{
+	return proc_bench_read(filp, buf, count, get_tlbbench);
+}
+
+/*
+ * Strbench file operations.
+ */
+struct file_operations proc_strbench_fops = {
+	.read		= proc_strbench_read,
+	.close		= proc_bench_close,
+};
+
+/*
+ * Strbench inode operations.
+ */
+struct inode_operations proc_strbench_iops = {
+	.fops		= &proc_strbench_fops,
+};
+
+/*
+ * Tlbbench file operations.
+ */
+struct file_operations proc_tlbbench_fops = {
+	.read		= proc_tlbbench_read,
+	.close		= proc_bench_close,
+};
+
+/*
+ * Tlbbench inode operations.
+ */
+struct inode_operations proc_tlbbench_iops = {
+	.fops		= &proc_tlbbench_fops,
+};
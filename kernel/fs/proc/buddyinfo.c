@@ -0,0 +1,54 @@
+#include <fs/fs.h>
+#include <mm/mm.h>
+#include <string.h>
+#include <stdio.h>
+#include <stderr.h>
+
+/*
+ * Read buddy allocator informations.
+ */
+static int proc_buddyinfo_read(struct file *filp, char *buf, int count)
+{
+	char *tmp_buf;
+	size_t len;
+
+	/* allocate temp buffer */
+	tmp_buf = (char *) get_free_page();
+	if (!tmp_buf)
+		return -ENOMEM;
+
+	/* get buddy allocator informations */
+	len = get_buddyinfo(tmp_buf, PAGE_SIZE);
+
+	/* file position after end */
+	if (filp->f_pos >= len) {
+		count = 0;
+		goto out;
+	}
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+out:
+	free_page(tmp_buf);
+	return count;
+}
+
+/*
+ * Buddyinfo file operations.
+ */
+struct file_operations proc_buddyinfo_fops = {
+	.read		= proc_buddyinfo_read,
+};
+
+/*
+ * Buddyinfo inode operations.
+ */
+struct inode_operations proc_buddyinfo_iops = {
+	.fops		= &proc_buddyinfo_fops,
+};
@@ -66,6 +66,52 @@ int proc_read_inode(struct inode *inode)
 				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
 				inode->i_op = &proc_net_dev_iops;
 				break;
+			case PROC_SLABINFO_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_slabinfo_iops;
+				break;
+			case PROC_VMSTAT_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_vmstat_iops;
+				break;
+			case PROC_BUDDYINFO_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_buddyinfo_iops;
+				break;
+			case PROC_SYS_INO:
+				inode->i_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH | S_IXUSR | S_IXGRP | S_IXOTH;
+				inode->i_nlinks = 2;
+				inode->i_op = &proc_sys_iops;
+				break;
+			case PROC_SYS_VM_INO:
+				inode->i_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH | S_IXUSR | S_IXGRP | S_IXOTH;
+				inode->i_nlinks = 2;
+				inode->i_op = &proc_sys_vm_iops;
+				break;
+			case PROC_SYS_VM_FREEPAGES_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_freepages_iops;
+				break;
+			case PROC_SYS_VM_FAULT_AROUND_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_fault_around_iops;
+				break;
+			case PROC_SWAPS_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_swaps_iops;
+				break;
+			case PROC_STRBENCH_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_strbench_iops;
+				break;
+			case PROC_KMEMSTAT_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_kmemstat_iops;
+				break;
+			case PROC_TLBBENCH_INO:
+				inode->i_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH;
+				inode->i_op = &proc_tlbbench_iops;
+				break;
 			default:
 				inode->i_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH | S_IXUSR | S_IXGRP | S_IXOTH;
 				inode->i_nlinks = 2;
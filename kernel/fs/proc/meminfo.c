@@ -1,5 +1,7 @@
 #include <fs/proc_fs.h>
 #include <mm/paging.h>
+#include <mm/swap.h>
+#include <mm/vmalloc.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -8,11 +10,27 @@
  */
 static int proc_meminfo_read(struct file *filp, char *buf, int count)
 {
-	char tmp_buf[256];
+	struct page_usage usage;
+	char tmp_buf[512];
 	size_t len;
 
 	/* print meminfo */
 	len = sprintf(tmp_buf, "MemTotal:\t%d kB\n", nr_pages * PAGE_SIZE / 1024);
+	len += sprintf(tmp_buf + len, "MemFree:\t%d kB\n", nr_free_pages() * PAGE_SIZE / 1024);
+	get_page_usage(&usage);
+	len += sprintf(tmp_buf + len, "Buffers:\t%d kB\n", usage.buffers);
+	len += sprintf(tmp_buf + len, "Cached:\t%d kB\n", usage.cached);
+	len += sprintf(tmp_buf + len, "SwapCached:\t%d kB\n", usage.swap_cached);
+	len += sprintf(tmp_buf + len, "AnonPages:\t%d kB\n", usage.anon);
+	len += sprintf(tmp_buf + len, "Slab:\t\t%d kB\n", usage.slab);
+	len += sprintf(tmp_buf + len, "KernelStack:\t%d kB\n", usage.kernel_stacks);
+	len += sprintf(tmp_buf + len, "PageTables:\t%d kB\n", usage.page_tables);
+	len += sprintf(tmp_buf + len, "SwapTotal:\t%d kB\n", total_swap_pages * PAGE_SIZE / 1024);
+	len += sprintf(tmp_buf + len, "SwapFree:\t%d kB\n", nr_swap_pages * PAGE_SIZE / 1024);
+	len += sprintf(tmp_buf + len, "VmallocTotal:\t%d kB\n", (vmalloc_end - vmalloc_start) / 1024);
+	len += sprintf(tmp_buf + len, "VmallocUsed:\t%d kB\n", nr_vmalloc_pages * PAGE_SIZE / 1024);
+	len += sprintf(tmp_buf + len, "AnonHugePages:\t%d kB\n", nr_huge_pages * HPAGE_SIZE / 1024);
+	len += sprintf(tmp_buf + len, "Hugepagesize:\t%d kB\n", pse_enabled ? HPAGE_SIZE / 1024 : 0);
 
 	/* file position after end */
 	if (filp->f_pos >= len)
@@ -21,6 +21,14 @@ static struct proc_dir_entry root_dir[] = {
 	{ PROC_MEMINFO_INO,	7,	"meminfo" },
 	{ PROC_LOADAVG_INO,	7,	"loadavg" },
 	{ PROC_NET_INO,		3,	"net" },
+	{ PROC_SLABINFO_INO,	8,	"slabinfo" },
+	{ PROC_VMSTAT_INO,	6,	"vmstat" },
+	{ PROC_BUDDYINFO_INO,	9,	"buddyinfo" },
+	{ PROC_SYS_INO,		3,	"sys" },
+	{ PROC_SWAPS_INO,	5,	"swaps" },
+	{ PROC_STRBENCH_INO,	8,	"strbench" },
+	{ PROC_KMEMSTAT_INO,	8,	"kmemstat" },
+	{ PROC_TLBBENCH_INO,	8,	"tlbbench" },
 };
 
 /*
@@ -0,0 +1,55 @@
+#include <fs/fs.h>
+#include <mm/mm.h>
+#include <mm/slab.h>
+#include <string.h>
+#include <stdio.h>
+#include <stderr.h>
+
+/*
+ * Read slab informations.
+ */
+static int proc_slabinfo_read(struct file *filp, char *buf, int count)
+{
+	char *tmp_buf;
+	size_t len;
+
+	/* allocate temp buffer */
+	tmp_buf = (char *) get_free_page();
+	if (!tmp_buf)
+		return -ENOMEM;
+
+	/* get slab informations */
+	len = get_slabinfo(tmp_buf, PAGE_SIZE);
+
+	/* file position after end */
+	if (filp->f_pos >= len) {
+		count = 0;
+		goto out;
+	}
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+out:
+	free_page(tmp_buf);
+	return count;
+}
+
+/*
+ * Slabinfo file operations.
+ */
+struct file_operations proc_slabinfo_fops = {
+	.read		= proc_slabinfo_read,
+};
+
+/*
+ * Slabinfo inode operations.
+ */
+struct inode_operations proc_slabinfo_iops = {
+	.fops		= &proc_slabinfo_fops,
+};
@@ -0,0 +1,55 @@
+#include <fs/fs.h>
+#include <mm/mm.h>
+#include <mm/swap.h>
+#include <string.h>
+#include <stdio.h>
+#include <stderr.h>
+
+/*
+ * Read swap areas.
+ */
+static int proc_swaps_read(struct file *filp, char *buf, int count)
+{
+	char *tmp_buf;
+	size_t len;
+
+	/* allocate temp buffer */
+	tmp_buf = (char *) get_free_page();
+	if (!tmp_buf)
+		return -ENOMEM;
+
+	/* get swap areas informations */
+	len = get_swaps(tmp_buf, PAGE_SIZE);
+
+	/* file position after end */
+	if (filp->f_pos >= len) {
+		count = 0;
+		goto out;
+	}
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+out:
+	free_page(tmp_buf);
+	return count;
+}
+
+/*
+ * Swaps file operations.
+ */
+struct file_operations proc_swaps_fops = {
+	.read		= proc_swaps_read,
+};
+
+/*
+ * Swaps inode operations.
+ */
+struct inode_operations proc_swaps_iops = {
+	.fops		= &proc_swaps_fops,
+};
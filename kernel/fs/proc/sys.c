@@ -0,0 +1,333 @@
+#include <fs/proc_fs.h>
+#include <mm/mm.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stderr.h>
+
+#define NR_SYS_DIRENTRY		(sizeof(sys_dir) / sizeof(sys_dir[0]))
+#define NR_SYS_VM_DIRENTRY	(sizeof(sys_vm_dir) / sizeof(sys_vm_dir[0]))
+
+/*
+ * Sys directory.
+ */
+static struct proc_dir_entry sys_dir[] = {
+	{ PROC_SYS_INO,		1, 	"." },
+	{ PROC_ROOT_INO,	2,	".." },
+	{ PROC_SYS_VM_INO,	2,	"vm" },
+};
+
+/*
+ * Sys vm directory.
+ */
+static struct proc_dir_entry sys_vm_dir[] = {
+	{ PROC_SYS_VM_INO,		1, 	"." },
+	{ PROC_SYS_INO,			2,	".." },
+	{ PROC_SYS_VM_FREEPAGES_INO,	9,	"freepages" },
+	{ PROC_SYS_VM_FAULT_AROUND_INO,	18,	"fault_around_pages" },
+};
+
+/*
+ * Read a sys directory.
+ */
+static int proc_sys_read_dir(struct file *filp, void *dirp, size_t count, struct proc_dir_entry *dir, size_t nr_entries)
+{
+	struct dirent64 *dirent = (struct dirent64 *) dirp;
+	int ret, n;
+	size_t i;
+
+	/* read dir entries */
+	for (i = filp->f_pos, n = 0; i < nr_entries; i++, filp->f_pos++) {
+		/* fill in directory entry */
+		ret = filldir(dirent, dir[i].name, dir[i].name_len, dir[i].ino, count);
+		if (ret)
+			return n;
+
+		/* go to next dir entry */
+		count -= dirent->d_reclen;
+		n += dirent->d_reclen;
+		dirent = (struct dirent64 *) ((void *) dirent + dirent->d_reclen);
+	}
+
+	return n;
+}
+
+/*
+ * Lookup a sys directory.
+ */
+static int proc_sys_lookup_dir(struct inode *dir, const char *name, size_t name_len, struct inode **res_inode,
+			       struct proc_dir_entry *entries, size_t nr_entries)
+{
+	ino_t ino;
+	size_t i;
+
+	/* dir must be a directory */
+	if (!dir)
+		return -ENOENT;
+	if (!S_ISDIR(dir->i_mode)) {
+		iput(dir);
+		return -ENOENT;
+	}
+
+	/* find matching entry */
+	for (i = 0; i < nr_entries; i++) {
+		if (proc_match(name, name_len, &entries[i])) {
+			ino = entries[i].ino;
+			break;
+		}
+	}
+
+	/* no matching entry */
+	if (i >= nr_entries) {
+		iput(dir);
+		return -ENOENT;
+	}
+
+	/* get inode */
+	*res_inode = iget(dir->i_sb, ino);
+	if (!*res_inode) {
+		iput(dir);
+		return -EACCES;
+	}
+
+	iput(dir);
+	return 0;
+}
+
+/*
+ * Read sys dir.
+ */
+static int proc_sys_getdents64(struct file *filp, void *dirp, size_t count)
+{
+	return proc_sys_read_dir(filp, dirp, count, sys_dir, NR_SYS_DIRENTRY);
+}
+
+/*
+ * Lookup sys dir.
+ */
+static int proc_sys_lookup(struct inode *dir, const char *name, size_t name_len, struct inode **res_inode)
+{
+	return proc_sys_lookup_dir(dir, name, name_len, res_inode, sys_dir, NR_SYS_DIRENTRY);
+}
+
+/*
+ * Sys file operations.
+ */
+struct file_operations proc_sys_fops = {
+	.getdents64		= proc_sys_getdents64,
+};
+
+/*
+ * Sys inode operations.
+ */
+struct inode_operations proc_sys_iops = {
+	.fops			= &proc_sys_fops,
+	.lookup			= proc_sys_lookup,
+};
+
+/*
+ * Read sys vm dir.
+ */
+static int proc_sys_vm_getdents64(struct file *filp, void *dirp, size_t count)
+{
+	return proc_sys_read_dir(filp, dirp, count, sys_vm_dir, NR_SYS_VM_DIRENTRY);
+}
+
+/*
+ * Lookup sys vm dir.
+ */
+static int proc_sys_vm_lookup(struct inode *dir, const char *name, size_t name_len, struct inode **res_inode)
+{
+	return proc_sys_lookup_dir(dir, name, name_len, res_inode, sys_vm_dir, NR_SYS_VM_DIRENTRY);
+}
+
+/*
+ * Sys vm file operations.
+ */
+struct file_operations proc_sys_vm_fops = {
+	.getdents64		= proc_sys_vm_getdents64,
+};
+
+/*
+ * Sys vm inode operations.
+ */
+struct inode_operations proc_sys_vm_iops = {
+	.fops			= &proc_sys_vm_fops,
+	.lookup			= proc_sys_vm_lookup,
+};
+
+/*
+ * Read free pages watermarks.
+ */
+static int proc_freepages_read(struct file *filp, char *buf, int count)
+{
+	char tmp_buf[64];
+	size_t len;
+
+	/* print watermarks */
+	len = sprintf(tmp_buf, "%u\t%u\t%u\n", freepages.min, freepages.low, freepages.high);
+
+	/* file position after end */
+	if (filp->f_pos >= len)
+		return 0;
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+	return count;
+}
+
+/*
+ * Parse an unsigned integer.
+ */
+static const char *proc_parse_uint(const char *s, uint32_t *val)
+{
+	/* skip spaces */
+	while (*s == ' ' || *s == '\t')
+		s++;
+
+	/* no number */
+	if (*s < '0' || *s > '9')
+		return NULL;
+
+	/* parse number */
+	for (*val = 0; *s >= '0' && *s <= '9'; s++)
+		*val = *val * 10 + *s - '0';
+
+	return s;
+}
+
+/*
+ * Write free pages watermarks ("min low high").
+ */
+static int proc_freepages_write(struct file *filp, const char *buf, int count)
+{
+	uint32_t min, low, high;
+	char tmp_buf[64];
+	const char *s;
+
+	UNUSED(filp);
+
+	/* check size */
+	if (count <= 0 || count >= (int) sizeof(tmp_buf))
+		return -EINVAL;
+
+	/* copy user buffer */
+	memcpy(tmp_buf, buf, count);
+	tmp_buf[count] = 0;
+
+	/* parse watermarks */
+	s = proc_parse_uint(tmp_buf, &min);
+	if (s)
+		s = proc_parse_uint(s, &low);
+	if (s)
+		s = proc_parse_uint(s, &high);
+	if (!s)
+		return -EINVAL;
+
+	/* check watermarks */
+	if (!min || min > low || low > high || high >= nr_pages)
+		return -EINVAL;
+
+	/* set watermarks */
+	freepages.min = min;
+	freepages.low = low;
+	freepages.high = high;
+
+	/* free memory may already be under new watermark */
+	if (nr_free_pages() < freepages.low)
+		wakeup_kswapd();
+
+	return count;
+}
+
+/*
+ * Free pages file operations.
+ */
+struct file_operations proc_freepages_fops = {
+	.read		= proc_freepages_read,
+	.write		= proc_freepages_write,
+};
+
+/*
+ * Free pages inode operations.
+ */
+struct inode_operations proc_freepages_iops = {
+	.fops		= &proc_freepages_fops,
+};
+
+/*
+ * Read fault around pages.
+ */
+static int proc_fault_around_read(struct file *filp, char *buf, int count)
+{
+	char tmp_buf[64];
+	size_t len;
+
+	/* print number of pages */
+	len = sprintf(tmp_buf, "%u\n", fault_around_pages);
+
+	/* file position after end */
+	if (filp->f_pos >= len)
+		return 0;
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+	return count;
+}
+
+/*
+ * Write fault around pages (rounded down to a power of 2, 0 or 1 disables fault around).
+ */
+static int proc_fault_around_write(struct file *filp, const char *buf, int count)
+{
+	uint32_t nr, pages;
+	char tmp_buf[64];
+
+	UNUSED(filp);
+
+	/* check size */
+	if (count <= 0 || count >= (int) sizeof(tmp_buf))
+		return -EINVAL;
+
+	/* copy user buffer */
+	memcpy(tmp_buf, buf, count);
+	tmp_buf[count] = 0;
+
+	/* parse number of pages (window must fit in a page table) */
+	if (!proc_parse_uint(tmp_buf, &nr) || nr > 1024)
+		return -EINVAL;
+
+	/* round down to a power of 2 */
+	pages = 1;
+	while (pages * 2 <= nr)
+		pages *= 2;
+	fault_around_pages = nr ? pages : 0;
+
+	return count;
+}
+
+/*
+ * Fault around file operations.
+ */
+struct file_operations proc_fault_around_fops = {
+	.read		= proc_fault_around_read,
+	.write		= proc_fault_around_write,
+};
+
+/*
+ * Fault around inode operations.
+ */
+struct inode_operations proc_fault_around_iops = {
+	.fops		= &proc_fault_around_fops,
+};
@@ -0,0 +1,81 @@
+#include <fs/proc_fs.h>
+#include <kernel_stat.h>
+#include <mm/mm.h>
+#include <string.h>
+#include <stderr.h>
+#include <stdio.h>
+
+/*
+ * Read virtual memory statistics.
+ */
+static int proc_vmstat_read(struct file *filp, char *buf, int count)
+{
+	char tmp_buf[1024];
+	size_t len;
+
+	/* print copy on write, page reclaim, page fault, readahead and pre-zeroed pages statistics */
+	len = sprintf(tmp_buf,	"cow_shared %u\n"
+				"cow_faults %u\n"
+				"cow_saved %u\n"
+				"nr_active %u\n"
+				"nr_inactive %u\n"
+				"pgscan %u\n"
+				"pgsteal %u\n"
+				"kswapd_wakeups %u\n"
+				"pswpin %u\n"
+				"pswpout %u\n"
+				"pgfault %u\n"
+				"pgfault_around %u\n"
+				"readahead_pages %u\n"
+				"readahead_hit %u\n"
+				"readahead_miss %u\n"
+				"nr_zero_pages %u\n"
+				"pgzero_idle %u\n"
+				"pgalloc_prezeroed %u\n",
+		      kstat.cow_shared,
+		      kstat.cow_faults,
+		      kstat.cow_saved,
+		      nr_active_pages,
+		      nr_inactive_pages,
+		      kstat.pgscan,
+		      kstat.pgsteal,
+		      kstat.kswapd_wakeups,
+		      kstat.pswpin,
+		      kstat.pswpout,
+		      kstat.pgfault,
+		      kstat.pgfault_around,
+		      kstat.readahead_pages,
+		      kstat.readahead_hit,
+		      kstat.readahead_miss,
+		      nr_zero_pages,
+		      kstat.pgzero_idle,
+		      kstat.pgalloc_prezeroed);
+
+	/* file position after end */
+	if (filp->f_pos >= len)
+		return 0;
+
+	/* update count */
+	if (filp->f_pos + count > len)
+		count = len - filp->f_pos;
+
+	/* copy content to user buffer and update file position */
+	memcpy(buf, tmp_buf + filp->f_pos, count);
+	filp->f_pos += count;
+
+	return count;
+}
+
+/*
+ * Vmstat file operations.
+ */
+struct file_operations proc_vmstat_fops = {
+	.read		= proc_vmstat_read,
+};
+
+/*
+ * Vmstat inode operations.
+ */
+struct inode_operations proc_vmstat_iops = {
+	.fops		= &proc_vmstat_fops,
+};
@@ -360,6 +360,7 @@ static int do_umount(const char *target, int flags)
 {
 	struct super_block *sb;
 	struct inode *inode;
+	int ret;
 
 	/* unused flags */
 	UNUSED(flags);
@@ -386,7 +387,9 @@ static int do_umount(const char *target, int flags)
 	}
 
 	/* sync buffers */
-	bsync_dev(sb->s_dev);
+	ret = bsync_dev(sb->s_dev);
+	if (ret)
+		return ret;
 
 	/* unmount file system */
 	sb->s_covered->i_mount = NULL;
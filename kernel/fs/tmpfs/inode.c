@@ -171,7 +171,7 @@ int tmpfs_inode_grow_size(struct inode *inode, size_t size)
 			goto err;
 
 		/* memzero page */
-		memset((void *) PAGE_ADDRESS(page), 0, PAGE_SIZE);
+		clear_page((void *) PAGE_ADDRESS(page));
 
 		/* add page to directory */
 		list_del(&page->list);
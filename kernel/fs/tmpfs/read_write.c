@@ -117,7 +117,7 @@ int tmpfs_readpage(struct inode *inode, struct page *page)
 		}
 
 		/* copy data */
-		memcpy((void *) PAGE_ADDRESS(page), (void *) PAGE_ADDRESS(inode_page), PAGE_SIZE);
+		copy_page((void *) PAGE_ADDRESS(page), (void *) PAGE_ADDRESS(inode_page));
 		break;
 	}
 
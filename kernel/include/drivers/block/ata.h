@@ -2,6 +2,7 @@
 #define _ATA_H_
 
 #include <drivers/block/genhd.h>
+#include <drivers/block/blk_dev.h>
 #include <fs/fs.h>
 #include <stddef.h>
 
@@ -10,6 +11,10 @@
 #define ATA_SECTOR_SIZE			512
 #define ATAPI_SECTOR_SIZE		2048
 
+#define ATA_DMA_MAX_SECTORS		256					/* sectors per DMA command (28 bits commands) */
+#define ATA_PRD_MAX_SIZE		0x10000					/* bytes per PRD entry (must not cross a 64 KB boundary) */
+#define ATA_PRDT_ENTRIES		ATA_DMA_MAX_SECTORS			/* PRD entries (one per sector at worst) */
+
 #define ATA_PRIMARY			0x00
 #define ATA_SECONDARY			0x01
 #define ATA_PRIMARY_IO			0x1F0
@@ -111,12 +116,12 @@ struct ata_device {
 	uint16_t		io_base;
 	struct ata_identify	identify;
 	char			is_atapi;
+	size_t			sector_size;
 	struct gendisk		hd;
 	struct ata_prdt *	prdt;
-	uint8_t *		buf;
 	uint32_t		bar4;
-	int			(*read)(struct ata_device *, struct buffer_head *, uint32_t);
-	int			(*write)(struct ata_device *, struct buffer_head *, uint32_t);
+	int			(*start)(struct ata_device *, struct request *);	/* start a request */
+	int			(*end)(struct ata_device *, struct request *);		/* end a request on interrupt (NULL if start is synchronous) */
 };
 
 int init_ata();
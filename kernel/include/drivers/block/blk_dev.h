@@ -0,0 +1,41 @@
+#ifndef _BLK_DEV_H_
+#define _BLK_DEV_H_
+
+#include <fs/fs.h>
+#include <lib/list.h>
+#include <stddef.h>
+
+#define NR_REQUEST			64
+
+/*
+ * Block device request (contiguous sectors of a disk).
+ */
+struct request {
+	int				cmd;					/* READ or WRITE */
+	dev_t				dev;					/* disk */
+	uint32_t			sector;					/* first sector (from disk start) */
+	uint32_t			nr_sectors;				/* number of sectors */
+	size_t				size;					/* size in bytes */
+	struct buffer_head *		bh;					/* first buffer */
+	struct buffer_head *		bhtail;					/* last buffer */
+	struct list_head		list;					/* next request in queue */
+};
+
+/*
+ * Block device request queue.
+ */
+struct request_queue {
+	struct list_head		queue_head;				/* pending requests (sorted by disk and sector) */
+	struct request *		current_request;			/* request being served */
+	dev_t				last_dev;				/* elevator position */
+	uint32_t			last_sector;
+	size_t				max_size;				/* maximum request size */
+	void				(*request_fn)(struct request_queue *);	/* start pending requests */
+};
+
+void blk_init_queue(struct request_queue *q, void (*request_fn)(struct request_queue *), size_t max_size);
+int make_request(struct request_queue *q, int rw, struct buffer_head *bh, dev_t dev, uint32_t sector, uint32_t nr_sectors);
+struct request *blk_next_request(struct request_queue *q);
+void end_request(struct request_queue *q, int uptodate);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+extern uint32_t cpu_khz;
+
 void init_pit();
 
 #endif
@@ -189,6 +189,7 @@ int ext2_write_inode(struct inode *inode);
 int ext2_put_inode(struct inode *inode);
 struct buffer_head *ext2_bread(struct inode *inode, uint32_t block, int create);
 int ext2_bmap(struct inode *inode, int block);
+int ext2_get_block(struct inode *inode, int block);
 
 /* Ext2 inode alloc prototypes */
 struct inode *ext2_new_inode(struct inode *dir, mode_t mode);
@@ -221,8 +222,6 @@ int ext2_rename(struct inode *old_dir, const char *old_name, size_t old_name_len
 int ext2_mknod(struct inode *dir, const char *name, size_t name_len, mode_t mode, dev_t dev);
 
 /* Ext2 file prototypes */
-int ext2_file_read(struct file *filp, char *buf, int count);
-int ext2_file_write(struct file *filp, const char *buf, int count);
 int ext2_getdents64(struct file *filp, void *dirp, size_t count);
 
 /*
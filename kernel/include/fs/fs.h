@@ -29,6 +29,9 @@
 #define DEFAULT_BLOCK_SIZE_BITS		10
 #define DEFAULT_BLOCK_SIZE		(1 << DEFAULT_BLOCK_SIZE_BITS)
 
+#define READ				0
+#define WRITE				1
+
 struct super_block;
 
 /*
@@ -41,7 +44,13 @@ struct buffer_head {
 	int				b_ref;			/* reference counter */
 	char				b_dirt;			/* dirty flag */
 	char				b_uptodate;		/* up to date flag */
+	char				b_lock;			/* I/O in progress */
+	char				b_flush;		/* queued by a flush */
+	char				b_ioerror;		/* last I/O failed */
+	time_t				b_dirtytime;		/* time when buffer was dirtied */
 	dev_t				b_dev;			/* device number */
+	struct wait_queue *		b_wait;			/* tasks waiting for I/O completion */
+	struct buffer_head *		b_reqnext;		/* next buffer in block request */
 	struct buffer_head *		b_this_page;		/* next buffer in page */
 	struct list_head		b_list;			/* next buffer in list */
 	struct htable_link		b_htable;		/* buffer hash */
@@ -122,6 +131,7 @@ struct file {
 	char *				f_path;
 	void *				f_private;
 	struct file_operations *	f_op;
+	struct file_ra_state		f_ra;
 };
 
 /*
@@ -175,6 +185,7 @@ struct inode_operations {
 	int (*mknod)(struct inode *, const char *, size_t, mode_t, dev_t);
 	void (*truncate)(struct inode *);
 	int (*bmap)(struct inode *, int);
+	int (*get_block)(struct inode *, int);
 	int (*readpage)(struct inode *, struct page *);
 };
 
@@ -207,15 +218,24 @@ int get_vfs_mount_list(char *buf, int count);
 struct buffer_head *bread(dev_t dev, uint32_t block, size_t blocksize);
 int bwrite(struct buffer_head *bh);
 void brelse(struct buffer_head *bh);
-void bsync();
-void bsync_dev(dev_t dev);
+int bsync();
+int bsync_dev(dev_t dev);
+void mark_buffer_dirty(struct buffer_head *bh);
+int init_bdflush();
+void wait_on_buffer(struct buffer_head *bh);
+void unlock_buffer(struct buffer_head *bh);
 int binit();
 struct buffer_head *getblk(dev_t dev, uint32_t block, size_t blocksize);
-void try_to_free_buffer(struct buffer_head *bh);
+int try_to_free_buffer(struct buffer_head *bh);
 void set_blocksize(dev_t dev, size_t blocksize);
 int generic_block_read(struct file *filp, char *buf, int count);
 int generic_block_write(struct file *filp, const char *buf, int count);
 int generic_readpage(struct inode *inode, struct page *page);
+int wait_on_page(struct page *page);
+int generic_commit_write(struct inode *inode, struct page *page, uint32_t offset, size_t count);
+int try_to_free_page_buffers(struct page *page);
+void discard_page_buffers(struct page *page, uint32_t offset);
+int sync_inode_pages(struct inode *inode);
 
 /* inode operations */
 struct inode *iget(struct super_block *sb, ino_t ino);
@@ -241,10 +261,13 @@ struct inode_operations *char_get_driver(struct inode *inode);
 
 /* block device driver */
 struct inode_operations *block_get_driver(struct inode *inode);
+int ll_rw_block(int rw, struct buffer_head *bh);
 int block_read(struct buffer_head *bh);
 int block_write(struct buffer_head *bh);
 
 /* filemap operations */
+int generic_file_read(struct file *filp, char *buf, int count);
+int generic_file_write(struct file *filp, const char *buf, int count);
 int generic_file_mmap(struct inode *inode, struct vm_area *vma);
 
 /* generic operations */
@@ -322,6 +345,7 @@ int sys_truncate64(const char *pathname, off_t length);
 int sys_ftruncate64(int fd, off_t length);
 int sys_sync();
 int sys_fsync(int fd);
+int sys_fdatasync(int fd);
 ssize_t sys_sendfile64(int fd_out, int fd_in, off_t *offset, size_t count);
 
 /*
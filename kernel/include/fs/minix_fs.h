@@ -105,6 +105,7 @@ int minix_write_inode(struct inode *inode);
 int minix_put_inode(struct inode *inode);
 struct buffer_head *minix_getblk(struct inode *inode, int block, int create);
 int minix_bmap(struct inode *inode, int block);
+int minix_get_block(struct inode *inode, int block);
 
 /* minix truncate prototypes */
 void minix_truncate(struct inode *inode);
@@ -135,7 +136,6 @@ int minix_mknod(struct inode *dir, const char *name, size_t name_len, mode_t mod
 
 /* minix file prototypes */
 int minix_file_read(struct file *filp, char *buf, int count);
-int minix_file_write(struct file *filp, const char *buf, int count);
 int minix_getdents64(struct file *filp, void *dirp, size_t count);
 
 #endif
@@ -21,6 +21,17 @@
 #define PROC_PID_FD_INO		13
 #define PROC_NET_INO		14
 #define PROC_NET_DEV_INO	15
+#define PROC_SLABINFO_INO	16
+#define PROC_VMSTAT_INO		17
+#define PROC_BUDDYINFO_INO	18
+#define PROC_SYS_INO		19
+#define PROC_SYS_VM_INO		20
+#define PROC_SYS_VM_FREEPAGES_INO	21
+#define PROC_SWAPS_INO		22
+#define PROC_SYS_VM_FAULT_AROUND_INO	23
+#define PROC_STRBENCH_INO	24
+#define PROC_KMEMSTAT_INO	25
+#define PROC_TLBBENCH_INO	26
 
 /*
  * Procfs dir entry.
@@ -57,6 +68,17 @@ extern struct inode_operations proc_fd_iops;
 extern struct inode_operations proc_fd_link_iops;
 extern struct inode_operations proc_net_iops;
 extern struct inode_operations proc_net_dev_iops;
+extern struct inode_operations proc_slabinfo_iops;
+extern struct inode_operations proc_vmstat_iops;
+extern struct inode_operations proc_buddyinfo_iops;
+extern struct inode_operations proc_sys_iops;
+extern struct inode_operations proc_sys_vm_iops;
+extern struct inode_operations proc_freepages_iops;
+extern struct inode_operations proc_swaps_iops;
+extern struct inode_operations proc_fault_around_iops;
+extern struct inode_operations proc_strbench_iops;
+extern struct inode_operations proc_kmemstat_iops;
+extern struct inode_operations proc_tlbbench_iops;
 
 /*
  * Test if a name matches a directory entry.
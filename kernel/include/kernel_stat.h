@@ -9,6 +9,21 @@
 struct kernel_stat {
 	uint32_t	interrupts;
 	uint32_t	context_switch;
+	uint32_t	cow_shared;
+	uint32_t	cow_faults;
+	uint32_t	cow_saved;
+	uint32_t	pgscan;
+	uint32_t	pgsteal;
+	uint32_t	kswapd_wakeups;
+	uint32_t	pswpin;
+	uint32_t	pswpout;
+	uint32_t	pgfault;
+	uint32_t	pgfault_around;
+	uint32_t	readahead_pages;
+	uint32_t	readahead_hit;
+	uint32_t	readahead_miss;
+	uint32_t	pgzero_idle;
+	uint32_t	pgalloc_prezeroed;
 };
 
 extern struct kernel_stat kstat;
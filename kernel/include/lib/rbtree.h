@@ -0,0 +1,59 @@
+#ifndef _RBTREE_H_
+#define _RBTREE_H_
+
+#include <stddef.h>
+
+#define RB_RED				0
+#define RB_BLACK			1
+
+#define RB_ROOT				(struct rb_root) { NULL }
+#define rb_entry(ptr, type, member)	container_of(ptr, type, member)
+#define rb_entry_safe(ptr, type, member) ({ typeof(ptr) ____ptr = (ptr); ____ptr ? rb_entry(____ptr, type, member) : NULL; })
+
+/*
+ * Red black tree node.
+ */
+struct rb_node {
+	struct rb_node *		rb_parent;
+	struct rb_node *		rb_left;
+	struct rb_node *		rb_right;
+	int				rb_color;
+};
+
+/*
+ * Red black tree root.
+ */
+struct rb_root {
+	struct rb_node *		rb_node;
+};
+
+/*
+ * Augmented tree callbacks (used to maintain per subtree data).
+ */
+struct rb_augment_callbacks {
+	void (*propagate)(struct rb_node *node, struct rb_node *stop);
+	void (*copy)(struct rb_node *old, struct rb_node *new);
+	void (*rotate)(struct rb_node *old, struct rb_node *new);
+};
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+void rb_insert_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment);
+void rb_erase_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment);
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_last(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
+
+/*
+ * Link a node (caller must then call rb_insert_color() to rebalance the tree).
+ */
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link)
+{
+	node->rb_parent = parent;
+	node->rb_color = RB_RED;
+	node->rb_left = node->rb_right = NULL;
+	*link = node;
+}
+
+#endif
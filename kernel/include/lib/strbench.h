@@ -0,0 +1,8 @@
+#ifndef _STRBENCH_H_
+#define _STRBENCH_H_
+
+#include <stddef.h>
+
+int get_strbench(char *buf, int count);
+
+#endif
@@ -11,6 +11,7 @@
  */
 struct heap_block {
 	uint16_t		magic;
+	uint16_t		tag;
 	uint32_t		size;
 	uint8_t			free;
 	struct heap_block *	prev;
@@ -28,9 +29,21 @@ struct heap {
 	size_t			size;
 };
 
+/*
+ * Heap statistics.
+ */
+struct heap_stat {
+	uint32_t		nr_used;
+	uint32_t		used;
+	uint32_t		nr_free;
+	uint32_t		free;
+	uint32_t		largest_free;
+};
+
 struct heap *heap_create(uint32_t start_address, size_t size);
 void *heap_alloc(struct heap *heap, size_t size, uint8_t page_aligned);
 void heap_free(struct heap *heap, void *p);
 void heap_dump(struct heap *heap);
+void heap_stat(struct heap *heap, struct heap_stat *stat);
 
 #endif
@@ -2,6 +2,7 @@
 #define _MM_H_
 
 #include <lib/list.h>
+#include <lib/rbtree.h>
 #include <mm/paging.h>
 #include <stddef.h>
 
@@ -13,6 +14,47 @@
 #define KPAGE_END			0xF0000000
 #define USTACK_START			0xF8000000				/* user stack */
 #define USTACK_LIMIT			(8 * 1024 * 1024)			/* user stack limit = 8 MB */
+#define FAULT_AROUND_PAGES		16					/* cached pages mapped around a file fault */
+#define READAHEAD_MIN_PAGES		4					/* first readahead window */
+#define READAHEAD_MAX_PAGES		32					/* readahead window limit */
+#define ZERO_PAGES_MAX			256					/* pre-zeroed pages pool size limit */
+#define ZERO_PAGES_BATCH		8					/* pages zeroed by idle task between halts */
+#define KMALLOC_NR_SITES		256					/* kmalloc call sites accounting table size */
+
+/*
+ * Free pages watermarks.
+ */
+struct freepages {
+	uint32_t			min;					/* minimum free pages */
+	uint32_t			low;					/* wake up page reclaim daemon below */
+	uint32_t			high;					/* page reclaim daemon stops above */
+};
+
+/*
+ * Kmalloc call site accounting.
+ */
+struct kmalloc_site {
+	uint32_t			caller;					/* return address of kmalloc call */
+	uint32_t			nr_allocs;				/* number of allocations */
+	uint32_t			nr_frees;				/* number of frees */
+	uint32_t			bytes;					/* allocated bytes (not freed yet) */
+};
+
+extern uint32_t nr_active_pages;
+extern uint32_t nr_inactive_pages;
+extern struct freepages freepages;
+extern uint32_t fault_around_pages;
+extern uint32_t nr_zero_pages;
+
+/*
+ * File readahead state.
+ */
+struct file_ra_state {
+	uint32_t			start;					/* first page of last window read */
+	uint32_t			size;					/* window size in pages (0 = random access) */
+	uint32_t			async_start;				/* next window is read when this page is accessed */
+	uint32_t			next;					/* next page expected on sequential access */
+};
 
 /*
  * Virtual memory area structure.
@@ -20,13 +62,17 @@
 struct vm_area {
 	uint32_t			vm_start;
 	uint32_t			vm_end;
-	uint16_t			vm_flags;
+	uint32_t			vm_flags;
 	uint32_t			vm_page_prot;
 	off_t				vm_offset;
 	struct inode *			vm_inode;
 	struct vm_operations *		vm_ops;
-	struct list_head		list;
+	struct mm_struct *		vm_mm;					/* owner */
+	struct list_head		list;					/* sorted list of areas */
+	struct rb_node			rb;					/* areas tree (sorted by address) */
+	uint32_t			rb_subtree_gap;				/* largest free gap before an area of this subtree */
 	struct list_head		list_share;
+	struct file_ra_state		vm_ra;					/* file readahead state */
 };
 
 /*
@@ -42,11 +88,25 @@ void init_mem(uint32_t start, uint32_t end);
 void *kmalloc(uint32_t size);
 void *kmalloc_align(uint32_t size);
 void kfree(void *p);
+int get_kmemstat(char *buf, int count);
 struct page *__get_free_page();
+struct page *__get_zeroed_page();
 void *get_free_page();
+int refill_zero_pages();
 void __free_page(struct page *page);
 void free_page(void *address);
-void reclaim_pages();
+int reclaim_pages();
+void lru_cache_add(struct page *page);
+void lru_cache_del(struct page *page);
+void mark_page_accessed(struct page *page);
+int init_kswapd();
+void wakeup_kswapd();
 void truncate_inode_pages(struct inode *inode, off_t start);
+int page_cache_readahead(struct inode *inode, off_t offset, size_t count);
+void file_readahead(struct inode *inode, struct file_ra_state *ra, uint32_t index);
+int do_swap_page(struct vm_area *vma, uint32_t address, uint32_t *pte);
+int do_huge_page(struct page_directory *pgd, struct vm_area *vma, uint32_t address);
+void change_huge_protection(struct page_directory *pgd, struct vm_area *vma);
+int swap_out(uint32_t nr_to_swap);
 
 #endif
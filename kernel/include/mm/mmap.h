@@ -2,6 +2,7 @@
 #define _MMAP_H_
 
 #include <fs/fs.h>
+#include <mm/slab.h>
 #include <lib/list.h>
 #include <stddef.h>
 
@@ -15,12 +16,16 @@
 #define VM_DENYWRITE		0x0800
 #define VM_EXECUTABLE		0x1000
 #define VM_LOCKED		0x2000
+#define VM_HUGETLB		0x4000
+#define VM_SEQ_READ		0x8000		/* sequential access expected (madvise) */
+#define VM_RAND_READ		0x10000		/* random access expected (madvise) */
 
 #define MAP_SHARED       	1
 #define MAP_PRIVATE      	2
 #define MAP_TYPE         	0xF
 #define MAP_FIXED        	0x10
 #define MAP_ANONYMOUS    	0x20
+#define MAP_HUGETLB		0x40000
 
 #define MREMAP_MAYMOVE		1
 #define MREMAP_FIXED		2
@@ -30,6 +35,16 @@
 #define PROT_EXEC		0x4		/* page can be executed */
 #define PROT_NONE		0x0		/* page can not be accessed */
 
+#define MADV_NORMAL		0		/* no specific access pattern */
+#define MADV_RANDOM		1		/* random access : no read around */
+#define MADV_SEQUENTIAL		2		/* sequential access : read ahead */
+#define MADV_WILLNEED		3		/* pages will be needed : read them now */
+#define MADV_DONTNEED		4		/* pages are not needed : drop them */
+#define MADV_FREE		8		/* anonymous pages content can be discarded */
+
+/* memory regions cache (defined in mmap.c) */
+extern struct kmem_cache *vm_area_cache;
+
 void *do_mmap(uint32_t addr, size_t length, int prot, int flags, struct file *filp, off_t offset);
 int do_munmap(uint32_t addr, size_t length);
 void *do_mremap(uint32_t old_address, size_t old_size, size_t new_size, int flags, uint32_t new_address);
@@ -37,6 +52,9 @@ struct vm_area *find_vma(struct task *task, uint32_t addr);
 struct vm_area *find_vma_prev(struct task *task, uint32_t addr);
 struct vm_area *find_vma_next(struct task *task, uint32_t addr);
 struct vm_area *find_vma_intersection(struct task *task, uint32_t start, uint32_t end);
+void vma_link(struct mm_struct *mm, struct vm_area *vm);
+void vma_unlink(struct vm_area *vm);
+void vma_gap_update(struct vm_area *vm);
 void vmtruncate(struct inode *inode, off_t offset);
 
 void *sys_mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
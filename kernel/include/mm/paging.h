@@ -14,12 +14,21 @@
 #define PAGE_ALIGN_UP(addr)		(((addr) + PAGE_SIZE - 1) & PAGE_MASK)
 #define ALIGN_UP(addr, size)		(((addr) + size - 1) & (~(size - 1)))
 
+#define HPAGE_SHIFT			22
+#define HPAGE_SIZE			(1 << HPAGE_SHIFT)
+#define HPAGE_MASK			(~(HPAGE_SIZE - 1))
+#define HPAGE_ORDER			(HPAGE_SHIFT - PAGE_SHIFT)
+
+#define MAX_ORDER			11
+
 #define PAGE_PRESENT			0x001
 #define PAGE_RW				0x002
 #define PAGE_USER			0x004
 #define PAGE_PCD			0x010
 #define PAGE_ACCESSED			0x020
 #define PAGE_DIRTY			0x040
+#define PAGE_PSE			0x080			/* page directory entry maps a 4 MB page */
+#define PAGE_GLOBAL			0x100			/* entry is kept in TLB on page directory switch */
 
 #define PAGE_NONE			(PAGE_PRESENT | PAGE_ACCESSED)
 #define PAGE_SHARED			(PAGE_PRESENT | PAGE_RW | PAGE_USER | PAGE_ACCESSED)
@@ -53,12 +62,75 @@
 #define MAP_NR(addr)			(V2P(addr) >> PAGE_SHIFT)
 #define PAGE_ADDRESS(p)			(KPAGE_START + (p)->page * PAGE_SIZE)
 
+/*
+ * Flush a Translation Lookaside Buffer entry.
+ */
+static inline void flush_tlb(uint32_t address)
+{
+	__asm__ __volatile__("invlpg (%0)" :: "r" (address) : "memory");
+}
+
+/*
+ * Flush all Translation Lookaside Buffer entries.
+ */
+static inline void flush_tlb_all()
+{
+	uint32_t cr3;
+
+	__asm__ __volatile__("mov %%cr3, %0; mov %0, %%cr3" : "=r" (cr3) :: "memory");
+}
+
+/*
+ * Get smallest order of a block holding size bytes.
+ */
+static inline uint32_t get_order(size_t size)
+{
+	uint32_t order = 0;
+
+	for (size = (size - 1) >> PAGE_SHIFT; size; size >>= 1)
+		order++;
+
+	return order;
+}
+
 /* defined in paging.c */
+extern uint8_t pse_enabled;
+extern uint8_t sse2_enabled;
+extern struct page *zero_page;
+extern struct page_directory *current_pgd;
 extern uint32_t placement_address;
 extern uint32_t nr_pages;
 extern struct page *page_table;
 extern struct page_directory *kernel_pgd;
 
+/* defined in paging.s */
+void copy_page_rep(void *dst, const void *src);
+void clear_page_rep(void *dst);
+void copy_page_sse2(void *dst, const void *src);
+void clear_page_sse2(void *dst);
+
+/*
+ * Copy a page (addresses must be page aligned).
+ */
+static inline void copy_page(void *dst, const void *src)
+{
+	if (sse2_enabled)
+		copy_page_sse2(dst, src);
+	else
+		copy_page_rep(dst, src);
+}
+
+/*
+ * Clear a page (address must be page aligned).
+ */
+static inline void clear_page(void *dst)
+{
+	if (sse2_enabled)
+		clear_page_sse2(dst);
+	else
+		clear_page_rep(dst);
+}
+
 /*
  * Page directory structure.
  */
@@ -74,6 +146,14 @@ struct page_table {
 	uint32_t 		pages[1024];				/* pages */
 };
 
+/*
+ * Buddy allocator free area.
+ */
+struct free_area {
+	struct list_head	free_list;				/* free blocks */
+	uint32_t		nr_free;				/* number of free blocks */
+};
+
 /*
  * Page structure.
  */
@@ -83,23 +163,58 @@ struct page {
 	struct inode *		inode;					/* inode */
 	off_t			offset;					/* offset in inode */
 	struct buffer_head *	buffers;				/* buffers of this page */
+	struct slab *		slab;					/* slab of this page */
+	uint8_t			buddy;					/* set if page heads a free buddy block */
+	uint8_t			order;					/* free buddy block order */
+	uint8_t			active;					/* page is on active LRU list */
+	uint8_t			referenced;				/* page has been accessed recently */
+	uint8_t			locked;					/* page is being read (buffers are attached until wait_on_page) */
+	uint8_t			anon;					/* page holds anonymous user memory */
 	struct list_head	list;					/* next page */
+	struct list_head	lru;					/* LRU list */
 	struct htable_link	htable;					/* page hash */
 };
 
+/*
+ * Pages usage by category (in kB).
+ */
+struct page_usage {
+	uint32_t		cached;					/* page cache */
+	uint32_t		swap_cached;				/* swap cache */
+	uint32_t		buffers;				/* buffer cache */
+	uint32_t		slab;					/* slab caches */
+	uint32_t		page_tables;				/* page tables */
+	uint32_t		anon;					/* anonymous user memory */
+	uint32_t		kernel_stacks;				/* tasks kernel stacks (on kernel heap) */
+};
+
 int init_paging(uint32_t start, uint32_t end);
+struct page *alloc_pages(uint32_t order);
+void free_pages(struct page *page, uint32_t order);
+void *get_free_pages(uint32_t order);
+uint32_t nr_free_pages();
+void get_page_usage(struct page_usage *usage);
+int get_buddyinfo(char *buf, int count);
 int map_page(uint32_t address, struct page_directory *pgd, int pgprot);
 void unmap_pages(uint32_t start_address, uint32_t end_address, struct page_directory *pgd);
 int remap_page_range(uint32_t start, uint32_t phys_addr, size_t size, struct page_directory *pgd, int pgprot);
+int move_page_tables(struct page_directory *pgd, uint32_t old_address, uint32_t new_address, size_t size);
 void switch_page_directory(struct page_directory *pgd);
+void release_page_table(struct page_table *pgt);
 void page_fault_handler(struct registers *regs);
 struct page_directory *clone_page_directory(struct page_directory *pgd);
 void free_page_directory(struct page_directory *pgd);
 
+/* huge pages */
+extern uint32_t nr_huge_pages;
+uint32_t clone_huge_page(uint32_t pde);
+void free_huge_page(uint32_t pde);
+int get_tlbbench(char *buf, int count);
+
 /* page cache */
+struct page *__find_page(struct inode *inode, off_t offset);
 struct page *find_page(struct inode *inode, off_t offset);
 void add_to_page_cache(struct page *page, struct inode *inode, off_t offset);
-void update_vm_cache(struct inode *inode, const char *buf, size_t pos, size_t count);
 void truncate_inode_pages(struct inode *inode, off_t start);
 
 #endif
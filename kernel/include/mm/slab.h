@@ -0,0 +1,51 @@
+#ifndef _MM_SLAB_H_
+#define _MM_SLAB_H_
+
+#include <lib/list.h>
+#include <stddef.h>
+
+#define KMEM_CACHE_NAME_LEN		32
+#define KMALLOC_MIN_SIZE		32
+#define KMALLOC_MAX_SIZE		2048
+
+/*
+ * Slab structure (a page of objects).
+ */
+struct slab {
+	struct kmem_cache *		cache;					/* owner cache */
+	void *				s_mem;					/* first object */
+	uint32_t			inuse;					/* number of allocated objects */
+	uint32_t			free;					/* first free object index */
+	struct list_head		list;					/* next slab in cache */
+	uint16_t			bufctl[];				/* free objects chain */
+};
+
+/*
+ * Object cache structure.
+ */
+struct kmem_cache {
+	char				name[KMEM_CACHE_NAME_LEN];		/* cache name */
+	size_t				size;					/* object size */
+	uint32_t			num;					/* number of objects per slab */
+	uint8_t				off_slab;				/* slab descriptor stored outside of the page */
+	void				(*ctor)(void *);			/* object constructor */
+	uint32_t			nr_slabs;				/* number of slabs */
+	uint32_t			nr_active;				/* number of allocated objects */
+	struct list_head		slabs_full;				/* full slabs */
+	struct list_head		slabs_partial;				/* partial slabs */
+	struct list_head		slabs_free;				/* empty slabs */
+	struct list_head		list;					/* next cache */
+};
+
+int init_slab();
+struct kmem_cache *kmem_cache_create(const char *name, size_t size, void (*ctor)(void *));
+void *kmem_cache_alloc(struct kmem_cache *cache);
+void kmem_cache_free(struct kmem_cache *cache, void *obj);
+int kmem_cache_shrink(struct kmem_cache *cache);
+void kmem_cache_reap();
+struct kmem_cache *kmalloc_cache(size_t size);
+int kmem_free(void *obj);
+uint16_t *kmem_obj_tag(void *obj, size_t *size);
+int get_slabinfo(char *buf, int count);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef _MM_SWAP_H_
+#define _MM_SWAP_H_
+
+#include <mm/paging.h>
+#include <fs/fs.h>
+#include <stddef.h>
+
+#define MAX_SWAPFILES			8
+
+#define SWP_USED			1
+#define SWP_WRITEOK			3
+
+#define SWAP_CLUSTER			32
+
+#define SWAP_MAP_MAX			0xFE
+#define SWAP_MAP_BAD			0xFF
+
+#define SWAP_READ			0
+#define SWAP_WRITE			1
+
+/* swap entries are stored in non present page table entries */
+#define SWP_ENTRY(type, offset)		(((type) << 1) | ((offset) << PAGE_SHIFT))
+#define SWP_TYPE(entry)			(((entry) >> 1) & 0x3F)
+#define SWP_OFFSET(entry)		((entry) >> PAGE_SHIFT)
+#define PTE_SWAP(pte)			((pte) && !((pte) & PAGE_PRESENT))
+
+/*
+ * Swap header (first page of a swap area, built by mkswap).
+ */
+union swap_header {
+	struct {
+		char			reserved[PAGE_SIZE - 10];
+		char			magic[10];				/* SWAPSPACE2 */
+	} magic;
+	struct {
+		char			bootbits[1024];				/* space for disklabel */
+		uint32_t		version;				/* header version (1) */
+		uint32_t		last_page;				/* last usable page */
+		uint32_t		nr_badpages;				/* number of bad pages */
+		unsigned char		sws_uuid[16];
+		unsigned char		sws_volume[16];
+		uint32_t		padding[117];
+		uint32_t		badpages[1];				/* bad pages */
+	} info;
+};
+
+/*
+ * Swap area.
+ */
+struct swap_info {
+	uint32_t			flags;					/* SWP_USED/SWP_WRITEOK */
+	char *				name;					/* path */
+	struct inode *			swap_file;				/* swap file or block device inode */
+	dev_t				swap_device;				/* block device (0 for swap files) */
+	size_t				blocksize;				/* block size */
+	uint8_t *			swap_map;				/* slots usage counters */
+	uint32_t			max;					/* number of slots */
+	uint32_t			lowest_bit;				/* first free slot candidate */
+	uint32_t			highest_bit;				/* last free slot candidate */
+	uint32_t			inuse_pages;				/* number of used slots */
+};
+
+extern uint32_t nr_swap_pages;
+extern uint32_t total_swap_pages;
+
+uint32_t get_swap_page();
+void swap_free(uint32_t entry);
+void swap_duplicate(uint32_t entry);
+int rw_swap_page(int rw, uint32_t entry, struct page *page);
+struct page *lookup_swap_cache(uint32_t entry);
+void add_to_swap_cache(struct page *page, uint32_t entry);
+void delete_from_swap_cache(struct page *page);
+int is_swap_cache_page(struct page *page);
+int in_swap_cache(uint32_t entry);
+int get_swaps(char *buf, int count);
+int sys_swapon(const char *path, int swap_flags);
+int sys_swapoff(const char *path);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _MM_VMALLOC_H_
+#define _MM_VMALLOC_H_
+
+#include <stddef.h>
+
+#define VMALLOC_OFFSET			(4 * 1024 * 1024)			/* hole between kernel pages and vmalloc area */
+#define VMALLOC_MAX_SIZE		(256 * 1024 * 1024)			/* vmalloc area size limit */
+
+/*
+ * Virtually contiguous kernel area.
+ */
+struct vm_struct {
+	uint32_t			addr;					/* start address */
+	size_t				size;					/* size (including guard page) */
+	uint16_t			tag;					/* kmalloc call site */
+	struct vm_struct *		next;					/* next area (sorted by address) */
+};
+
+extern uint32_t vmalloc_start;
+extern uint32_t vmalloc_end;
+extern uint32_t nr_vmalloc_pages;
+
+/*
+ * Is an address in vmalloc area ?
+ */
+static inline int is_vmalloc_addr(void *addr)
+{
+	return (uint32_t) addr >= vmalloc_start && (uint32_t) addr < vmalloc_end;
+}
+
+int init_vmalloc();
+void *vmalloc(size_t size);
+void vfree(void *addr);
+struct vm_struct *find_vm_area(void *addr);
+
+#endif
@@ -70,6 +70,7 @@ static inline uint8_t *skb_pull(struct sk_buff *skb, size_t len)
 	return skb->data;
 }
 
+int init_skb();
 struct sk_buff *skb_alloc(size_t size);
 struct sk_buff *skb_clone(struct sk_buff *skb);
 void skb_free(struct sk_buff *skb);
@@ -7,7 +7,9 @@
 #include <fs/fs.h>
 #include <ipc/signal.h>
 #include <lib/list.h>
+#include <lib/rbtree.h>
 #include <x86/tls.h>
+#include <x86/fpu.h>
 #include <resource.h>
 #include <stddef.h>
 
@@ -38,6 +40,8 @@ struct mm_struct {
 	uint32_t			env_start;			/* start environ */
 	uint32_t			env_end;			/* end environ */
 	struct list_head		vm_list;			/* virtual memory areas */
+	struct rb_root			vm_rb;				/* virtual memory areas tree */
+	struct vm_area *		vm_cache;			/* last area found */
 };
 
 /*
@@ -111,8 +115,17 @@ struct task {
 	struct signal_struct *		sig;				/* signals */
 	struct semaphore *		vfork_sem;			/* vfork semaphore */
 	struct list_head		list;				/* next process */
+	char				fpu_state[FPU_STATE_SIZE + 16];	/* saved FPU/SSE registers (FXSAVE area) */
 };
 
+/*
+ * Get task's FXSAVE area (16 bytes aligned).
+ */
+static inline void *task_fpu_state(struct task *task)
+{
+	return (void *) ALIGN_UP((uint32_t) task->fpu_state, 16);
+}
+
 /*
  * Registers structure.
  */
@@ -138,11 +151,15 @@ struct binargs {
 	char	dont_free;
 };
 
+/* tasks cache (defined in task.c) */
+extern struct kmem_cache *task_cache;
+
 struct task *create_kernel_thread(void (*func)(void *), void *arg);
 struct task *create_init_task(struct task *parent);
 int do_fork(uint32_t clone_flags, uint32_t user_sp);
 void destroy_task(struct task *task);
 struct task *get_task(pid_t pid);
+struct mm_struct *task_new_mm();
 struct mm_struct *task_dup_mm(struct mm_struct *mm);
 void task_exit_signals(struct task *task);
 void task_exit_fs(struct task *task);
@@ -51,6 +51,7 @@
 #define __NR_getrusage			77
 #define __NR_symlink			83
 #define __NR_readlink			85
+#define __NR_swapon			87
 #define __NR_reboot			88
 #define __NR_mmap			90
 #define __NR_munmap			91
@@ -59,6 +60,7 @@
 #define __NR_syslog			103
 #define __NR_setitimer			104
 #define __NR_wait4			114
+#define __NR_swapoff			115
 #define __NR_sysinfo			116
 #define __NR_ipc			117
 #define __NR_fsync			118
@@ -75,6 +77,7 @@
 #define __NR_readv			145
 #define __NR_writev			146
 #define __NR_getsid			147
+#define __NR_fdatasync			148
 #define __NR_nanosleep			162
 #define __NR_mremap			163
 #define __NR_poll			168
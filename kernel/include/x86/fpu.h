@@ -0,0 +1,17 @@
+#ifndef _FPU_H_
+#define _FPU_H_
+
+#include <stddef.h>
+
+#define FPU_STATE_SIZE		512
+#define MXCSR_DEFAULT		0x1F80			/* all SSE exceptions masked */
+
+struct task;
+
+void init_fpu();
+void fpu_switch(struct task *next);
+void fpu_copy(struct task *task, struct task *parent);
+void fpu_reset(struct task *task);
+void fpu_release(struct task *task);
+
+#endif
@@ -9,6 +9,18 @@
 #define USER_DATA_SEGMENT	0x20
 #define TSS_SEGMENT		0x28
 
+#define X86_FEATURE_PSE		(1 << 3)		/* cpuid 1 edx : 4 MB pages */
+#define X86_FEATURE_PGE		(1 << 13)		/* cpuid 1 edx : global pages */
+#define X86_FEATURE_FXSR	(1 << 24)		/* cpuid 1 edx : fxsave/fxrstor */
+#define X86_FEATURE_SSE2	(1 << 26)		/* cpuid 1 edx : SSE2 instructions */
+
+#define X86_CR0_EM		0x00000004		/* x87 emulation (SSE instructions fault) */
+#define X86_CR0_TS		0x00000008		/* task switched (FPU instructions fault) */
+
+#define X86_CR4_PSE		0x00000010		/* enable 4 MB pages */
+#define X86_CR4_PGE		0x00000080		/* enable global pages */
+#define X86_CR4_OSFXSR		0x00000200		/* enable SSE instructions */
+
 struct registers {
 	uint32_t ds;
 	uint32_t edi;
@@ -28,6 +40,95 @@ struct registers {
 	uint32_t ss;
 };
 
+/*
+ * Get processor identification.
+ */
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+	__asm__ __volatile__("cpuid" : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx) : "a" (leaf), "c" (0));
+}
+
+/*
+ * Test a processor feature (cpuid 1 edx).
+ */
+static inline int cpu_has_feature(uint32_t feature)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	return (edx & feature) != 0;
+}
+
+/*
+ * Read CR0 register.
+ */
+static inline uint32_t read_cr0()
+{
+	uint32_t cr0;
+
+	__asm__ __volatile__("mov %%cr0, %0" : "=r" (cr0));
+	return cr0;
+}
+
+/*
+ * Write CR0 register.
+ */
+static inline void write_cr0(uint32_t cr0)
+{
+	__asm__ __volatile__("mov %0, %%cr0" :: "r" (cr0) : "memory");
+}
+
+/*
+ * Clear task switched flag (FPU/SSE instructions don't fault).
+ */
+static inline void clts()
+{
+	__asm__ __volatile__("clts");
+}
+
+/*
+ * Set task switched flag (next FPU/SSE instruction faults).
+ */
+static inline void stts()
+{
+	write_cr0(read_cr0() | X86_CR0_TS);
+}
+
+/*
+ * Read CR4 register.
+ */
+static inline uint32_t read_cr4()
+{
+	uint32_t cr4;
+
+	__asm__ __volatile__("mov %%cr4, %0" : "=r" (cr4));
+	return cr4;
+}
+
+/*
+ * Write CR4 register.
+ */
+static inline void write_cr4(uint32_t cr4)
+{
+	__asm__ __volatile__("mov %0, %%cr4" :: "r" (cr4) : "memory");
+}
+
+/*
+ * Save FPU/SSE registers (area must be 16 bytes aligned).
+ */
+static inline void fxsave(void *area)
+{
+	__asm__ __volatile__("fxsave (%0)" :: "r" (area) : "memory");
+}
+
+/*
+ * Restore FPU/SSE registers (area must be 16 bytes aligned).
+ */
+static inline void fxrstor(void *area)
+{
+	__asm__ __volatile__("fxrstor (%0)" :: "r" (area) : "memory");
+}
+
 /*
  * Halt the processor.
  */
@@ -17,6 +17,7 @@
 #include <drivers/block/ata.h>
 #include <drivers/video/fb.h>
 #include <drivers/net/rtl8139.h>
+#include <net/sk_buff.h>
 #include <proc/sched.h>
 #include <sys/syscall.h>
 #include <fs/minix_fs.h>
@@ -104,6 +105,16 @@ static int parse_mboot(unsigned long magic, unsigned long addr, uint32_t *mem_up
  */
 static void kinit()
 {
+	/* init page reclaim daemon */
+	printf("[Kernel] Page reclaim daemon Init\n");
+	if (init_kswapd() != 0)
+		panic("Cannot create page reclaim daemon");
+
+	/* init buffers flush daemon */
+	printf("[Kernel] Buffers flush daemon Init\n");
+	if (init_bdflush() != 0)
+		panic("Cannot create buffers flush daemon");
+
 	/* register filesystems */
 	printf("[Kernel] Register file systems\n");
 	if (init_minix_fs() != 0)
@@ -147,6 +158,11 @@ static void kinit()
 	if (init_mouse() != 0)
 		printf("[Kernel] Cannot init mouse\n");
 
+	/* init socket buffers */
+	printf("[Kernel] Socket buffers Init\n");
+	if (init_skb() != 0)
+		panic("Cannot create socket buffers cache");
+
 	/* init realtek 8139 device */
 	printf("[Kernel] Realtek 8139 card Init\n");
 	if (init_rtl8139(default_ip_address, default_ip_netmask, default_ip_route) != 0)
@@ -181,8 +197,9 @@ static void kinit()
 	if (spawn_init() != 0)
 		panic("Cannot spawn init process");
 
-	/* sleep forever */
+	/* idle loop : zero free pages between halts */
 	for (;;) {
+		refill_zero_pages();
 		current_task->state = TASK_SLEEPING;
 		halt();
 	}
@@ -332,7 +332,7 @@ static struct page *shm_nopage(struct vm_area *vma, uint32_t address)
 		return NULL;
 
 	/* memzero page */
-	memset((void *) new_page, 0, PAGE_SIZE);
+	clear_page((void *) new_page);
 
 	/* get page and add it to cache */
 	page = &page_table[MAP_NR(new_page)];
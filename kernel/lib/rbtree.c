@@ -0,0 +1,472 @@
+#include <lib/rbtree.h>
+
+/*
+ * Replace a child of parent (or tree root).
+ */
+static inline void __rb_change_child(struct rb_node *old, struct rb_node *new, struct rb_node *parent, struct rb_root *root)
+{
+	if (!parent)
+		root->rb_node = new;
+	else if (parent->rb_left == old)
+		parent->rb_left = new;
+	else
+		parent->rb_right = new;
+}
+
+/*
+ * Helper for rotations : new takes old place and color, old becomes a child of new.
+ */
+static inline void __rb_rotate_set_parents(struct rb_node *old, struct rb_node *new, struct rb_root *root, int color)
+{
+	struct rb_node *parent = old->rb_parent;
+
+	new->rb_parent = parent;
+	new->rb_color = old->rb_color;
+	old->rb_parent = new;
+	old->rb_color = color;
+	__rb_change_child(old, new, parent, root);
+}
+
+/*
+ * Rebalance a tree after insertion.
+ */
+static void __rb_insert(struct rb_node *node, struct rb_root *root, void (*augment_rotate)(struct rb_node *, struct rb_node *))
+{
+	struct rb_node *parent = node->rb_parent, *gparent, *tmp;
+
+	for (;;) {
+		/* node is root : it must be black */
+		if (!parent) {
+			node->rb_color = RB_BLACK;
+			break;
+		}
+
+		/* black parent : nothing to do */
+		if (parent->rb_color == RB_BLACK)
+			break;
+
+		gparent = parent->rb_parent;
+		tmp = gparent->rb_right;
+		if (parent != tmp) {
+			/* red uncle : flip colors and go up */
+			if (tmp && tmp->rb_color == RB_RED) {
+				tmp->rb_color = RB_BLACK;
+				parent->rb_color = RB_BLACK;
+				gparent->rb_color = RB_RED;
+				node = gparent;
+				parent = node->rb_parent;
+				continue;
+			}
+
+			/* node is a right child : left rotate at parent */
+			tmp = parent->rb_right;
+			if (node == tmp) {
+				tmp = node->rb_left;
+				parent->rb_right = tmp;
+				node->rb_left = parent;
+				if (tmp) {
+					tmp->rb_parent = parent;
+					tmp->rb_color = RB_BLACK;
+				}
+				parent->rb_parent = node;
+				parent->rb_color = RB_RED;
+				augment_rotate(parent, node);
+				parent = node;
+				tmp = node->rb_right;
+			}
+
+			/* right rotate at grand parent */
+			gparent->rb_left = tmp;
+			parent->rb_right = gparent;
+			if (tmp) {
+				tmp->rb_parent = gparent;
+				tmp->rb_color = RB_BLACK;
+			}
+			__rb_rotate_set_parents(gparent, parent, root, RB_RED);
+			augment_rotate(gparent, parent);
+			break;
+		} else {
+			/* red uncle : flip colors and go up */
+			tmp = gparent->rb_left;
+			if (tmp && tmp->rb_color == RB_RED) {
+				tmp->rb_color = RB_BLACK;
+				parent->rb_color = RB_BLACK;
+				gparent->rb_color = RB_RED;
+				node = gparent;
+				parent = node->rb_parent;
+				continue;
+			}
+
+			/* node is a left child : right rotate at parent */
+			tmp = parent->rb_left;
+			if (node == tmp) {
+				tmp = node->rb_right;
+				parent->rb_left = tmp;
+				node->rb_right = parent;
+				if (tmp) {
+					tmp->rb_parent = parent;
+					tmp->rb_color = RB_BLACK;
+				}
+				parent->rb_parent = node;
+				parent->rb_color = RB_RED;
+				augment_rotate(parent, node);
+				parent = node;
+				tmp = node->rb_left;
+			}
+
+			/* left rotate at grand parent */
+			gparent->rb_right = tmp;
+			parent->rb_left = gparent;
+			if (tmp) {
+				tmp->rb_parent = gparent;
+				tmp->rb_color = RB_BLACK;
+			}
+			__rb_rotate_set_parents(gparent, parent, root, RB_RED);
+			augment_rotate(gparent, parent);
+			break;
+		}
+	}
+}
+
+/*
+ * Rebalance a tree after a black node removal (parent lost a black node on one side).
+ */
+static void __rb_erase_color(struct rb_node *parent, struct rb_root *root, void (*augment_rotate)(struct rb_node *, struct rb_node *))
+{
+	struct rb_node *node = NULL, *sibling, *tmp1, *tmp2;
+
+	for (;;) {
+		sibling = parent->rb_right;
+		if (node != sibling) {
+			/* red sibling : left rotate at parent */
+			if (sibling->rb_color == RB_RED) {
+				tmp1 = sibling->rb_left;
+				parent->rb_right = tmp1;
+				sibling->rb_left = parent;
+				tmp1->rb_parent = parent;
+				tmp1->rb_color = RB_BLACK;
+				__rb_rotate_set_parents(parent, sibling, root, RB_RED);
+				augment_rotate(parent, sibling);
+				sibling = tmp1;
+			}
+
+			tmp1 = sibling->rb_right;
+			if (!tmp1 || tmp1->rb_color == RB_BLACK) {
+				/* black nephews : flip sibling color and go up if parent is black */
+				tmp2 = sibling->rb_left;
+				if (!tmp2 || tmp2->rb_color == RB_BLACK) {
+					sibling->rb_color = RB_RED;
+					if (parent->rb_color == RB_RED) {
+						parent->rb_color = RB_BLACK;
+					} else {
+						node = parent;
+						parent = node->rb_parent;
+						if (parent)
+							continue;
+					}
+					break;
+				}
+
+				/* red left nephew : right rotate at sibling */
+				tmp1 = tmp2->rb_right;
+				sibling->rb_left = tmp1;
+				tmp2->rb_right = sibling;
+				parent->rb_right = tmp2;
+				if (tmp1) {
+					tmp1->rb_parent = sibling;
+					tmp1->rb_color = RB_BLACK;
+				}
+				augment_rotate(sibling, tmp2);
+				tmp1 = sibling;
+				sibling = tmp2;
+			}
+
+			/* red right nephew : left rotate at parent */
+			tmp2 = sibling->rb_left;
+			parent->rb_right = tmp2;
+			sibling->rb_left = parent;
+			tmp1->rb_parent = sibling;
+			tmp1->rb_color = RB_BLACK;
+			if (tmp2)
+				tmp2->rb_parent = parent;
+			__rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
+			augment_rotate(parent, sibling);
+			break;
+		} else {
+			/* red sibling : right rotate at parent */
+			sibling = parent->rb_left;
+			if (sibling->rb_color == RB_RED) {
+				tmp1 = sibling->rb_right;
+				parent->rb_left = tmp1;
+				sibling->rb_right = parent;
+				tmp1->rb_parent = parent;
+				tmp1->rb_color = RB_BLACK;
+				__rb_rotate_set_parents(parent, sibling, root, RB_RED);
+				augment_rotate(parent, sibling);
+				sibling = tmp1;
+			}
+
+			tmp1 = sibling->rb_left;
+			if (!tmp1 || tmp1->rb_color == RB_BLACK) {
+				/* black nephews : flip sibling color and go up if parent is black */
+				tmp2 = sibling->rb_right;
+				if (!tmp2 || tmp2->rb_color == RB_BLACK) {
+					sibling->rb_color = RB_RED;
+					if (parent->rb_color == RB_RED) {
+						parent->rb_color = RB_BLACK;
+					} else {
+						node = parent;
+						parent = node->rb_parent;
+						if (parent)
+							continue;
+					}
+					break;
+				}
+
+				/* red right nephew : left rotate at sibling */
+				tmp1 = tmp2->rb_left;
+				sibling->rb_right = tmp1;
+				tmp2->rb_left = sibling;
+				parent->rb_left = tmp2;
+				if (tmp1) {
+					tmp1->rb_parent = sibling;
+					tmp1->rb_color = RB_BLACK;
+				}
+				augment_rotate(sibling, tmp2);
+				tmp1 = sibling;
+				sibling = tmp2;
+			}
+
+			/* red left nephew : right rotate at parent */
+			tmp2 = sibling->rb_right;
+			parent->rb_left = tmp2;
+			sibling->rb_right = parent;
+			tmp1->rb_parent = sibling;
+			tmp1->rb_color = RB_BLACK;
+			if (tmp2)
+				tmp2->rb_parent = parent;
+			__rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
+			augment_rotate(parent, sibling);
+			break;
+		}
+	}
+}
+
+/*
+ * Unlink a node from a tree (returns the node to rebalance from or NULL).
+ */
+static struct rb_node *__rb_erase(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
+{
+	struct rb_node *child = node->rb_right, *tmp = node->rb_left;
+	struct rb_node *parent, *rebalance, *successor, *child2;
+
+	if (!tmp) {
+		/* no left child : replace node by its right child */
+		parent = node->rb_parent;
+		__rb_change_child(node, child, parent, root);
+		if (child) {
+			child->rb_parent = parent;
+			child->rb_color = node->rb_color;
+			rebalance = NULL;
+		} else {
+			rebalance = node->rb_color == RB_BLACK ? parent : NULL;
+		}
+		tmp = parent;
+	} else if (!child) {
+		/* no right child : replace node by its left child */
+		parent = node->rb_parent;
+		tmp->rb_parent = parent;
+		tmp->rb_color = node->rb_color;
+		__rb_change_child(node, tmp, parent, root);
+		rebalance = NULL;
+		tmp = parent;
+	} else {
+		successor = child;
+		tmp = child->rb_left;
+		if (!tmp) {
+			/* successor is node right child */
+			parent = successor;
+			child2 = successor->rb_right;
+			augment->copy(node, successor);
+		} else {
+			/* successor is the leftmost node of right subtree */
+			do {
+				parent = successor;
+				successor = tmp;
+				tmp = tmp->rb_left;
+			} while (tmp);
+
+			child2 = successor->rb_right;
+			parent->rb_left = child2;
+			successor->rb_right = child;
+			child->rb_parent = successor;
+			augment->copy(node, successor);
+			augment->propagate(parent, successor);
+		}
+
+		/* successor takes node place */
+		tmp = node->rb_left;
+		successor->rb_left = tmp;
+		tmp->rb_parent = successor;
+		__rb_change_child(node, successor, node->rb_parent, root);
+
+		if (child2) {
+			child2->rb_parent = parent;
+			child2->rb_color = RB_BLACK;
+			rebalance = NULL;
+		} else {
+			rebalance = successor->rb_color == RB_BLACK ? parent : NULL;
+		}
+
+		successor->rb_parent = node->rb_parent;
+		successor->rb_color = node->rb_color;
+		tmp = successor;
+	}
+
+	augment->propagate(tmp, NULL);
+	return rebalance;
+}
+
+/*
+ * Dummy augmented callbacks (for plain trees).
+ */
+static void dummy_propagate(struct rb_node *node, struct rb_node *stop)
+{
+	UNUSED(node);
+	UNUSED(stop);
+}
+
+static void dummy_copy(struct rb_node *old, struct rb_node *new)
+{
+	UNUSED(old);
+	UNUSED(new);
+}
+
+static void dummy_rotate(struct rb_node *old, struct rb_node *new)
+{
+	UNUSED(old);
+	UNUSED(new);
+}
+
+static const struct rb_augment_callbacks dummy_callbacks = {
+	.propagate	= dummy_propagate,
+	.copy		= dummy_copy,
+	.rotate		= dummy_rotate,
+};
+
+/*
+ * Rebalance a tree after a node has been linked.
+ */
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+	__rb_insert(node, root, dummy_rotate);
+}
+
+/*
+ * Remove a node from a tree.
+ */
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *rebalance;
+
+	rebalance = __rb_erase(node, root, &dummy_callbacks);
+	if (rebalance)
+		__rb_erase_color(rebalance, root, dummy_rotate);
+}
+
+/*
+ * Rebalance an augmented tree after a node has been linked (caller must have updated augmented data
+ * on the path leading to the node).
+ */
+void rb_insert_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
+{
+	__rb_insert(node, root, augment->rotate);
+}
+
+/*
+ * Remove a node from an augmented tree.
+ */
+void rb_erase_augmented(struct rb_node *node, struct rb_root *root, const struct rb_augment_callbacks *augment)
+{
+	struct rb_node *rebalance;
+
+	rebalance = __rb_erase(node, root, augment);
+	if (rebalance)
+		__rb_erase_color(rebalance, root, augment->rotate);
+}
+
+/*
+ * Get first node (in sort order).
+ */
+struct rb_node *rb_first(const struct rb_root *root)
+{
+	struct rb_node *node = root->rb_node;
+
+	if (!node)
+		return NULL;
+
+	while (node->rb_left)
+		node = node->rb_left;
+
+	return node;
+}
+
+/*
+ * Get last node (in sort order).
+ */
+struct rb_node *rb_last(const struct rb_root *root)
+{
+	struct rb_node *node = root->rb_node;
+
+	if (!node)
+		return NULL;
+
+	while (node->rb_right)
+		node = node->rb_right;
+
+	return node;
+}
+
+/*
+ * Get next node (in sort order).
+ */
+struct rb_node *rb_next(const struct rb_node *node)
+{
+	struct rb_node *parent;
+
+	/* leftmost node of right subtree */
+	if (node->rb_right) {
+		node = node->rb_right;
+		while (node->rb_left)
+			node = node->rb_left;
+		return (struct rb_node *) node;
+	}
+
+	/* else first ancestor of which node is in left subtree */
+	while ((parent = node->rb_parent) && node == parent->rb_right)
+		node = parent;
+
+	return parent;
+}
+
+/*
+ * Get previous node (in sort order).
+ */
+struct rb_node *rb_prev(const struct rb_node *node)
+{
+	struct rb_node *parent;
+
+	/* rightmost node of left subtree */
+	if (node->rb_left) {
+		node = node->rb_left;
+		while (node->rb_right)
+			node = node->rb_right;
+		return (struct rb_node *) node;
+	}
+
+	/* else first ancestor of which node is in right subtree */
+	while ((parent = node->rb_parent) && node == parent->rb_left)
+		node = parent;
+
+	return parent;
+}
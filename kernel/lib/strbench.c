@@ -0,0 +1,116 @@
+#include <lib/strbench.h>
+#include <drivers/char/pit.h>
+#include <x86/interrupt.h>
+#include <mm/mm.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_BUF_ORDER			4					/* 64 kB buffers */
+#define BENCH_BUF_SIZE			(PAGE_SIZE << BENCH_BUF_ORDER)
+#define BENCH_BYTES			(1024 * 1024)				/* bytes processed per size class */
+
+#define BENCH_MEMCPY			0
+#define BENCH_MEMSET			1
+#define BENCH_MEMCMP			2
+#define BENCH_STRLEN			3
+#define NR_BENCH			4
+
+/* size classes */
+static const size_t bench_sizes[] = { 16, 64, 256, 1024, 4096, 65536 };
+
+/*
+ * Read Time Stamp Counter.
+ */
+static inline uint64_t bench_clock()
+{
+	uint32_t low, high;
+
+	rdtsc(low, high);
+	return ((uint64_t) high << 32) | low;
+}
+
+/*
+ * Run a function on BENCH_BYTES bytes by chunks of size bytes (returns rate in MB/s).
+ */
+static uint32_t bench_run(int func, char *dst, char *src, size_t size)
+{
+	uint32_t nr_loops, i, flags;
+	uint64_t start, cycles;
+
+	/* prepare buffers (equal areas for memcmp, a string of size - 1 characters for strlen) */
+	memset(src, 'a', size);
+	memset(dst, 'a', size);
+	src[size - 1] = 0;
+	dst[size - 1] = 0;
+
+	/* run function */
+	nr_loops = BENCH_BYTES / size;
+	irq_save(flags);
+	start = bench_clock();
+	for (i = 0; i < nr_loops; i++) {
+		switch (func) {
+			case BENCH_MEMCPY:
+				memcpy(dst, src, size);
+				break;
+			case BENCH_MEMSET:
+				memset(dst, 0, size);
+				break;
+			case BENCH_MEMCMP:
+				memcmp(dst, src, size);
+				break;
+			case BENCH_STRLEN:
+				strlen(src);
+				break;
+		}
+	}
+	cycles = bench_clock() - start;
+	irq_restore(flags);
+
+	/* compute rate */
+	if (!cycles)
+		return 0;
+
+	return (uint64_t) nr_loops * size * cpu_khz * 1000 / cycles / (1024 * 1024);
+}
+
+/*
+ * Benchmark string functions (MB/s per size class).
+ */
+int get_strbench(char *buf, int count)
+{
+	char *src, *dst;
+	size_t i;
+	int len, func;
+
+	/* CPU frequency is needed to convert cycles */
+	if (!cpu_khz)
+		return sprintf(buf, "Time Stamp Counter not calibrated\n");
+
+	/* allocate buffers */
+	src = get_free_pages(BENCH_BUF_ORDER);
+	if (!src)
+		return 0;
+	dst = get_free_pages(BENCH_BUF_ORDER);
+	if (!dst) {
+		free_pages(&page_table[MAP_NR((uint32_t) src)], BENCH_BUF_ORDER);
+		return 0;
+	}
+
+	/* print header */
+	len = sprintf(buf, "size\tmemcpy\tmemset\tmemcmp\tstrlen\t(MB/s)\n");
+
+	/* run all functions on all size classes */
+	for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]) && len < count - 64; i++) {
+		len += sprintf(buf + len, "%d", bench_sizes[i]);
+		for (func = 0; func < NR_BENCH; func++)
+			len += sprintf(buf + len, "\t%d", bench_run(func, dst, src, bench_sizes[i]));
+		len += sprintf(buf + len, "\n");
+	}
+
+	/* free buffers */
+	free_pages(&page_table[MAP_NR((uint32_t) src)], BENCH_BUF_ORDER);
+	free_pages(&page_table[MAP_NR((uint32_t) dst)], BENCH_BUF_ORDER);
+
+	return len;
+}
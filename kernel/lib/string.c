@@ -2,17 +2,29 @@
 #include <string.h>
 #include <stddef.h>
 
+/* a double word contains a zero byte */
+#define HAS_ZERO(x)			(((x) - 0x01010101) & ~(x) & 0x80808080)
+
 /*
  * Compute length of a string
  */
 size_t strlen(const char *s)
 {
-	size_t size = 0;
+	const uint32_t *wp;
+	const char *p;
 
-	while (s[size] != '\0')
-		size++;
+	/* align pointer */
+	for (p = s; (uint32_t) p & 3; p++)
+		if (!*p)
+			return p - s;
 
-	return size;
+	/* test 4 bytes at a time (aligned reads never cross a page boundary) */
+	for (wp = (const uint32_t *) p; !HAS_ZERO(*wp); wp++);
+
+	/* find zero byte */
+	for (p = (const char *) wp; *p; p++);
+
+	return p - s;
 }
 
 /*
@@ -100,7 +112,26 @@ char *strdup(const char *s)
  */
 char *strchr(const char *s, char c)
 {
-	for (; *s; s++)
+	uint32_t mask = (uint8_t) c * 0x01010101, w;
+	const uint32_t *wp;
+
+	/* align pointer */
+	for (; (uint32_t) s & 3; s++) {
+		if (!*s)
+			return NULL;
+		if (*s == c)
+			return (char *) s;
+	}
+
+	/* skip 4 bytes at a time until a zero byte or c is found */
+	for (wp = (const uint32_t *) s;; wp++) {
+		w = *wp;
+		if (HAS_ZERO(w) || HAS_ZERO(w ^ mask))
+			break;
+	}
+
+	/* find byte */
+	for (s = (const char *) wp; *s; s++)
 		if (*s == c)
 			return (char *) s;
 
@@ -139,15 +170,60 @@ size_t strcspn(const char *s, const char *reject)
 	return l;
 }
 
+/*
+ * Copy memory area with string instructions (double words, then remaining bytes).
+ */
+static inline void __memcpy(void *dest, const void *src, size_t n)
+{
+	uint32_t d0, d1, d2;
+
+	__asm__ __volatile__("rep movsl\n\t"
+			     "movl %4, %%ecx\n\t"
+			     "andl $3, %%ecx\n\t"
+			     "jz 1f\n\t"
+			     "rep movsb\n"
+			     "1:"
+			     : "=&c" (d0), "=&D" (d1), "=&S" (d2)
+			     : "0" (n / 4), "g" (n), "1" (dest), "2" (src)
+			     : "memory");
+}
+
+/*
+ * Fill memory with a double word pattern (double words, then remaining bytes).
+ */
+static inline void __memset(void *s, uint32_t v, size_t n)
+{
+	uint32_t d0, d1;
+
+	__asm__ __volatile__("rep stosl\n\t"
+			     "movl %3, %%ecx\n\t"
+			     "andl $3, %%ecx\n\t"
+			     "jz 1f\n\t"
+			     "rep stosb\n"
+			     "1:"
+			     : "=&c" (d0), "=&D" (d1)
+			     : "0" (n / 4), "g" (n), "a" (v), "1" (s)
+			     : "memory");
+}
+
 /*
  * Fill memory with a constant byte.
  */
 void memset(void *s, char v, size_t n)
 {
+	uint32_t pattern = (uint8_t) v * 0x01010101;
 	char *sp = (char *) s;
+	size_t head;
+
+	/* align destination on a double word */
+	if (n >= 16) {
+		head = -(uint32_t) sp & 3;
+		__memset(sp, pattern, head);
+		sp += head;
+		n -= head;
+	}
 
-	for (; n != 0; n--)
-		*sp++ = v;
+	__memset(sp, pattern, n);
 }
 
 /*
@@ -155,10 +231,12 @@ void memset(void *s, char v, size_t n)
  */
 void memsetw(void *s, uint16_t v, size_t n)
 {
-	uint16_t *sp = (uint16_t *) s;
+	uint32_t d0, d1;
 
-	for (; n != 0; n--)
-		*sp++ = v;
+	__asm__ __volatile__("rep stosw"
+			     : "=&c" (d0), "=&D" (d1)
+			     : "0" (n), "a" (v), "1" (s)
+			     : "memory");
 }
 
 /*
@@ -166,10 +244,12 @@ void memsetw(void *s, uint16_t v, size_t n)
  */
 void memsetdw(void *s, uint32_t v, size_t n)
 {
-	uint32_t *sp = (uint32_t *) s;
+	uint32_t d0, d1;
 
-	for (; n != 0; n--)
-		*sp++ = v;
+	__asm__ __volatile__("rep stosl"
+			     : "=&c" (d0), "=&D" (d1)
+			     : "0" (n), "a" (v), "1" (s)
+			     : "memory");
 }
 
 /*
@@ -177,10 +257,17 @@ void memsetdw(void *s, uint32_t v, size_t n)
  */
 int memcmp(const void *s1, const void *s2, size_t n)
 {
-	const char *sp1 = (const char *) s1;
-	const char *sp2 = (const char *) s2;
+	const uint8_t *sp1 = (const uint8_t *) s1;
+	const uint8_t *sp2 = (const uint8_t *) s2;
 
-	while (n-- > 0) {
+	/* skip equal double words */
+	for (; n >= 4 && *((const uint32_t *) sp1) == *((const uint32_t *) sp2); n -= 4) {
+		sp1 += 4;
+		sp2 += 4;
+	}
+
+	/* find first different byte */
+	for (; n > 0; n--) {
 		if (*sp1 != *sp2)
 			return (int) *sp1 - (int) *sp2;
 
@@ -207,30 +294,24 @@ void *memcpyb(void *dest, const void *src, size_t n)
 }
 
 /*
- * Optimized memcpy.
+ * Optimized memcpy (string instructions only : it may copy to or from user memory and fault).
  */
 void *memcpy(void *dest, const void *src, size_t n)
 {
-	uint32_t nb_dwords, nb_bytes;
-	uint32_t *dest32, *src32;
-	uint8_t *dest8,*src8;
-
-	/* compute number of double words */
-	nb_dwords = n / sizeof(uint32_t);
-	dest32 = (uint32_t *) dest;
-	src32 = (uint32_t *) src;
-
-	/* compute number of remaining bytes */
-	nb_bytes = n % sizeof(uint32_t);
-	dest8 = ((uint8_t *) dest) + nb_dwords * sizeof(uint32_t);
-	src8 = ((uint8_t *) src) + nb_dwords * sizeof(uint32_t);
-
-	while (nb_dwords-- > 0)
-		*dest32++ = *src32++;
-
-	while (nb_bytes-- > 0)
-		*dest8++ = *src8++;
+	const char *sp = (const char *) src;
+	char *dp = (char *) dest;
+	size_t head;
+
+	/* align destination on a double word */
+	if (n >= 16) {
+		head = -(uint32_t) dp & 3;
+		__memcpy(dp, sp, head);
+		dp += head;
+		sp += head;
+		n -= head;
+	}
 
+	__memcpy(dp, sp, n);
 	return dest;
 }
 
@@ -239,13 +320,19 @@ void *memcpy(void *dest, const void *src, size_t n)
  */
 void *memmovew(uint16_t *dest, const uint16_t *src, size_t n)
 {
+	uint32_t d0, d1, d2;
+
 	if (dest < src)
 		return memcpy(dest, src, n * 2);
 
-	dest += n - 1;
-	src += n - 1;
-	while (n--)
-		*dest-- = *src--;
+	/* copy backward */
+	if (n)
+		__asm__ __volatile__("std\n\t"
+				     "rep movsw\n\t"
+				     "cld"
+				     : "=&c" (d0), "=&D" (d1), "=&S" (d2)
+				     : "0" (n), "1" (dest + n - 1), "2" (src + n - 1)
+				     : "memory");
 
 	return dest;
 }
@@ -255,13 +342,19 @@ void *memmovew(uint16_t *dest, const uint16_t *src, size_t n)
  */
 void *memmovedw(uint32_t *dest, const uint32_t *src, size_t n)
 {
+	uint32_t d0, d1, d2;
+
 	if (dest < src)
 		return memcpy(dest, src, n * 4);
 
-	dest += n - 1;
-	src += n - 1;
-	while (n--)
-		*dest-- = *src--;
+	/* copy backward */
+	if (n)
+		__asm__ __volatile__("std\n\t"
+				     "rep movsl\n\t"
+				     "cld"
+				     : "=&c" (d0), "=&D" (d1), "=&S" (d2)
+				     : "0" (n), "1" (dest + n - 1), "2" (src + n - 1)
+				     : "memory");
 
 	return dest;
 }
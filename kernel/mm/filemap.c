@@ -1,45 +1,274 @@
 #include <mm/mmap.h>
 #include <mm/paging.h>
 #include <proc/sched.h>
+#include <kernel_stat.h>
 #include <fcntl.h>
 #include <stderr.h>
 
 /*
- * Fill a page.
+ * Remove a page from page cache (caller must hold a reference on it).
  */
-static struct page *fill_page(struct inode *inode, off_t offset)
+static void remove_from_page_cache(struct page *page)
+{
+	htable_delete(&page->htable);
+	list_del(&page->list);
+	INIT_LIST_HEAD(&page->list);
+	__free_page(page);
+}
+
+/*
+ * Fill a page (if read is not set, a new page is zeroed instead of being read from disk).
+ */
+static struct page *fill_page(struct inode *inode, off_t offset, int read, int *err)
 {
 	struct page *page;
 	uint32_t new_page;
 
 	/* try to get page from cache */
 	page = find_page(inode, offset);
-	if (page)
-		return page;
+	if (!page) {
+		/* get a new page */
+		new_page = (uint32_t) get_free_page();
+		if (!new_page) {
+			*err = -ENOMEM;
+			return NULL;
+		}
 
-	/* get a new page */
-	new_page = (uint32_t) get_free_page();
-	if (!new_page)
-		return NULL;
+		/* get page and add it to cache */
+		page = &page_table[MAP_NR(new_page)];
+		add_to_page_cache(page, inode, offset);
+
+		/* no need to read : zero page */
+		if (!read) {
+			clear_page((void *) new_page);
+			return page;
+		}
 
-	/* get page and add it to cache */
-	page = &page_table[MAP_NR(new_page)];
-	add_to_page_cache(page, inode, offset);
+		/* start read */
+		*err = inode->i_op->readpage(inode, page);
+		if (*err)
+			goto err;
+	}
 
-	/* read page */
-	inode->i_op->readpage(inode, page);
+	/* wait for read (page may have been read ahead, another reader may have dropped it on error) */
+	if (wait_on_page(page) || __find_page(inode, offset) != page) {
+		*err = -EIO;
+		goto err;
+	}
 
 	return page;
+err:
+	if (__find_page(inode, offset) == page)
+		remove_from_page_cache(page);
+	__free_page(page);
+	return NULL;
+}
+
+/*
+ * Read pages into page cache (reads are started but not waited for).
+ */
+int page_cache_readahead(struct inode *inode, off_t offset, size_t count)
+{
+	struct page *page;
+	uint32_t new_page;
+	off_t end;
+
+	/* no read operation */
+	if (!inode->i_op || !inode->i_op->readpage)
+		return -EINVAL;
+
+	/* stop at end of file */
+	end = offset + count;
+	if (end > inode->i_size)
+		end = inode->i_size;
+
+	for (offset = PAGE_ALIGN_DOWN(offset); offset < end; offset += PAGE_SIZE) {
+		/* page already cached */
+		if (__find_page(inode, offset))
+			continue;
+
+		/* get a new page */
+		new_page = (uint32_t) get_free_page();
+		if (!new_page)
+			return -ENOMEM;
+
+		/* get page and add it to cache */
+		page = &page_table[MAP_NR(new_page)];
+		add_to_page_cache(page, inode, offset);
+		kstat.readahead_pages++;
+
+		/* start read (drop page on error) */
+		if (inode->i_op->readpage(inode, page))
+			remove_from_page_cache(page);
+
+		/* keep page only in cache */
+		__free_page(page);
+	}
+
+	return 0;
+}
+
+/*
+ * Update a file readahead window on a page access (window grows on sequential access
+ * and collapses on random access, next window is read while current one is consumed).
+ */
+void file_readahead(struct inode *inode, struct file_ra_state *ra, uint32_t index)
+{
+	/* same page as previous access */
+	if (index + 1 == ra->next)
+		return;
+
+	/* random access : collapse window */
+	if (index != ra->next && (!ra->size || index < ra->next || index >= ra->start + ra->size)) {
+		ra->next = index + 1;
+		ra->size = 0;
+		return;
+	}
+
+	/* sequential access : page should have been read ahead */
+	ra->next = index + 1;
+	if (__find_page(inode, (off_t) index << PAGE_SHIFT))
+		kstat.readahead_hit++;
+	else
+		kstat.readahead_miss++;
+
+	if (!ra->size) {
+		/* start a window from this page */
+		ra->start = index;
+		ra->size = READAHEAD_MIN_PAGES;
+		ra->async_start = index + 1;
+	} else if (index >= ra->async_start) {
+		/* current window reached : read next one (twice bigger) */
+		ra->start += ra->size;
+		ra->size = ra->size * 2 > READAHEAD_MAX_PAGES ? READAHEAD_MAX_PAGES : ra->size * 2;
+		ra->async_start = ra->start;
+	} else {
+		return;
+	}
+
+	page_cache_readahead(inode, (off_t) ra->start << PAGE_SHIFT, ra->size << PAGE_SHIFT);
+}
+
+/*
+ * Generic file read (through page cache).
+ */
+int generic_file_read(struct file *filp, char *buf, int count)
+{
+	struct inode *inode = filp->f_inode;
+	size_t offset, nb_chars, left;
+	struct page *page;
+	int ret = 0;
+
+	/* adjust size */
+	if (filp->f_pos + count > inode->i_size)
+		count = inode->i_size - filp->f_pos;
+
+	/* no more data to read */
+	if (count <= 0)
+		return 0;
+
+	/* read page by page */
+	for (left = count; left > 0;) {
+		/* update readahead window */
+		file_readahead(inode, &filp->f_ra, filp->f_pos >> PAGE_SHIFT);
+
+		/* get page */
+		page = fill_page(inode, PAGE_ALIGN_DOWN(filp->f_pos), 1, &ret);
+		if (!page)
+			break;
+
+		/* find position and number of chars to read */
+		offset = filp->f_pos & ~PAGE_MASK;
+		nb_chars = PAGE_SIZE - offset <= left ? PAGE_SIZE - offset : left;
+
+		/* copy to user buffer */
+		memcpy(buf, (void *) (PAGE_ADDRESS(page) + offset), nb_chars);
+
+		/* release page */
+		__free_page(page);
+
+		/* update sizes */
+		filp->f_pos += nb_chars;
+		buf += nb_chars;
+		left -= nb_chars;
+	}
+
+	inode->i_atime = CURRENT_TIME;
+	inode->i_dirt = 1;
+
+	/* nothing read : return error */
+	if (ret && left == (size_t) count)
+		return ret;
+
+	return count - left;
+}
+
+/*
+ * Generic file write (through page cache, page buffers are written back by flush daemon).
+ */
+int generic_file_write(struct file *filp, const char *buf, int count)
+{
+	struct inode *inode = filp->f_inode;
+	size_t offset, nb_chars, left;
+	struct page *page;
+	int ret = 0, read;
+
+	/* handle append flag */
+	if (filp->f_flags & O_APPEND)
+		filp->f_pos = inode->i_size;
+
+	/* write page by page */
+	for (left = count; left > 0;) {
+		/* find position and number of chars to write */
+		offset = filp->f_pos & ~PAGE_MASK;
+		nb_chars = PAGE_SIZE - offset <= left ? PAGE_SIZE - offset : left;
+
+		/* get page (read it first only if it is partially written and holds file data) */
+		read = nb_chars < PAGE_SIZE && PAGE_ALIGN_DOWN(filp->f_pos) < inode->i_size;
+		page = fill_page(inode, PAGE_ALIGN_DOWN(filp->f_pos), read, &ret);
+		if (!page)
+			break;
+
+		/* copy to page */
+		memcpy((void *) (PAGE_ADDRESS(page) + offset), buf, nb_chars);
+
+		/* map written blocks and mark them dirty */
+		ret = generic_commit_write(inode, page, offset, nb_chars);
+
+		/* release page */
+		__free_page(page);
+		if (ret)
+			break;
+
+		/* update sizes */
+		filp->f_pos += nb_chars;
+		buf += nb_chars;
+		left -= nb_chars;
+
+		/* end of file : grow it */
+		if (filp->f_pos > inode->i_size)
+			inode->i_size = filp->f_pos;
+	}
+
+	inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+	inode->i_dirt = 1;
+
+	/* nothing written : return error */
+	if (ret && left == (size_t) count)
+		return ret;
+
+	return count - left;
 }
 
 /*
- * Handle a page fault = read page from file.
+ * Handle a page fault = read page from file (private mappings map the cached page read only
+ * and get their own copy on first write).
  */
 static struct page *filemap_nopage(struct vm_area *vma, uint32_t address)
 {
 	struct inode *inode = vma->vm_inode;
-	struct page *page, *new_page;
 	uint32_t offset;
+	int err;
 
 	/* page align address */
 	address = PAGE_ALIGN_DOWN(address);
@@ -49,22 +278,12 @@ static struct page *filemap_nopage(struct vm_area *vma, uint32_t address)
 	if (offset >= inode->i_size)
 		return NULL;
 
-	/* fill in page */
-	page = fill_page(inode, offset);
-
-	/* no share : copy to new page and keep old page in offset */
-	if (page && !(vma->vm_flags & VM_SHARED)) {
-		/* get a new page */
-		new_page = __get_free_page();
-		if (new_page)
-			memcpy((void *) PAGE_ADDRESS(new_page), (void *) PAGE_ADDRESS(page), PAGE_SIZE);
-
-		/* release cache page */
-		__free_page(page);
-		return new_page;
-	}
+	/* update readahead window (unless random access is expected) */
+	if (!(vma->vm_flags & VM_RAND_READ))
+		file_readahead(inode, &vma->vm_ra, offset >> PAGE_SHIFT);
 
-	return page;
+	/* fill in page */
+	return fill_page(inode, offset, 1, &err);
 }
 
 /*
@@ -132,8 +351,12 @@ void truncate_inode_pages(struct inode *inode, off_t start)
 		page = list_entry(pos, struct page, list);
 		offset = page->offset;
 
-		/* full page truncate */
+		/* wait for pending read */
+		wait_on_page(page);
+
+		/* full page truncate (truncated blocks must never be written back) */
 		if (offset >= start) {
+			discard_page_buffers(page, 0);
 			htable_delete(&page->htable);
 			__free_page(page);
 			continue;
@@ -141,45 +364,9 @@ void truncate_inode_pages(struct inode *inode, off_t start)
 
 		/* partial page truncate */
 		offset = start - offset;
-		if (offset < PAGE_SIZE)
+		if (offset < PAGE_SIZE) {
 			memset((void *) (uint32_t) (PAGE_ADDRESS(page) + offset), 0, PAGE_SIZE - offset);
-	}
-}
-
-/*
- * Update a page cache copy.
- */
-void update_vm_cache(struct inode *inode, const char *buf, size_t pos, size_t count)
-{
-	struct page *page;
-	off_t offset;
-	size_t len;
-	void *addr;
-
-	offset = pos & ~PAGE_MASK;
-	pos = pos & PAGE_MASK;
-	len = PAGE_SIZE - offset;
-
-	while (count > 0) {
-		/* adjust size */
-		if (len > count)
-			len = count;
-
-		/* find page in cache */
-		page = find_page(inode, pos);
-		if (page) {
-			/* update page */
-			addr = (void *) PAGE_ADDRESS(page);
-			memcpy(addr + offset, buf, len);
-
-			/* release page */
-			__free_page(page);
+			discard_page_buffers(page, offset);
 		}
-
-		count -= len;
-		buf += len;
-		pos += PAGE_SIZE;
-		len = PAGE_SIZE;
-		offset = 0;
 	}
 }
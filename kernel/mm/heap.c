@@ -2,6 +2,7 @@
 #include <mm/paging.h>
 #include <mm/mm.h>
 #include <stdio.h>
+#include <string.h>
 #include <stderr.h>
 
 #define HEAP_BLOCK_DATA(block)			((uint32_t) (block) + sizeof(struct heap_block))
@@ -31,6 +32,7 @@ struct heap *heap_create(uint32_t start_address, size_t size)
 
 	/* create first block */
 	heap->first_block->magic = HEAP_MAGIC;
+	heap->first_block->tag = 0;
 	heap->first_block->size = size - sizeof(struct heap_block);
 	heap->first_block->free = 1;
 	heap->first_block->prev = NULL;
@@ -87,6 +89,7 @@ void *heap_alloc(struct heap *heap, size_t size, uint8_t page_aligned)
 		/* move block */
 		new_block = (void *) block + page_offset;
 		new_block->magic = HEAP_MAGIC;
+		new_block->tag = 0;
 		new_block->size = block->size - page_offset;
 		new_block->prev = block->prev;
 		new_block->next = block->next;
@@ -112,6 +115,7 @@ void *heap_alloc(struct heap *heap, size_t size, uint8_t page_aligned)
 		/* create new free block */
 		new_block = (struct heap_block *) (HEAP_BLOCK_DATA(block) + size);
 		new_block->magic = HEAP_MAGIC;
+		new_block->tag = 0;
 		new_block->size = block->size - size - sizeof(struct heap_block);
 		new_block->free = 1;
 		new_block->prev = block;
@@ -174,3 +178,26 @@ void heap_dump(struct heap *heap)
 	for (block = heap->first_block; block != NULL; block = block->next)
 		printf("%x\t%d\t%d\n", (uint32_t) block, block->size, block->free);
 }
+
+/*
+ * Get heap statistics (used/free blocks and largest free block).
+ */
+void heap_stat(struct heap *heap, struct heap_stat *stat)
+{
+	struct heap_block *block;
+
+	memset(stat, 0, sizeof(struct heap_stat));
+
+	for (block = heap->first_block; block != NULL; block = block->next) {
+		if (!block->free) {
+			stat->nr_used++;
+			stat->used += block->size;
+			continue;
+		}
+
+		stat->nr_free++;
+		stat->free += block->size;
+		if (block->size > stat->largest_free)
+			stat->largest_free = block->size;
+	}
+}
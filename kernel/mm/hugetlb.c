@@ -0,0 +1,200 @@
+#include <mm/mm.h>
+#include <mm/mmap.h>
+#include <mm/paging.h>
+#include <mm/vmalloc.h>
+#include <x86/interrupt.h>
+#include <stderr.h>
+#include <stdio.h>
+#include <time.h>
+
+#define TLBBENCH_PASSES			16
+#define TLBBENCH_BLOCKS			4					/* 16 MB working set limit */
+#define TLBBENCH_MULT			0x9E3779B1				/* odd multiplier : page order permutation */
+
+/* number of 4 MB pages mapped in user space */
+uint32_t nr_huge_pages = 0;
+
+/* TLB benchmark working set sizes (one access per page) */
+static const size_t tlbbench_sizes[] = { 64 * 1024, 256 * 1024, 1024 * 1024, 4096 * 1024, 16384 * 1024 };
+
+/*
+ * Handle a huge page fault (map a zeroed 4 MB page).
+ */
+int do_huge_page(struct page_directory *pgd, struct vm_area *vma, uint32_t address)
+{
+	uint32_t idx = address >> HPAGE_SHIFT;
+	struct page *page;
+	uint32_t i;
+
+	/* already mapped */
+	if (pgd->tables_physical[idx] & PAGE_PSE)
+		return -EPERM;
+
+	/* get a 4 MB block */
+	page = alloc_pages(HPAGE_ORDER);
+	if (!page)
+		return -ENOMEM;
+
+	/* memzero page */
+	for (i = 0; i < HPAGE_SIZE; i += PAGE_SIZE)
+		clear_page((void *) (PAGE_ADDRESS(page) + i));
+
+	/* drop empty page table left by a previous mapping */
+	if (pgd->tables[idx]) {
+		release_page_table(pgd->tables[idx]);
+		pgd->tables[idx] = NULL;
+	}
+
+	/* huge pages are never shared (they are copied on fork), so writable regions are mapped writable */
+	pgd->tables_physical[idx] = (page->page << PAGE_SHIFT) | PAGE_PSE | PAGE_DIRTY
+		| (vma->vm_flags & VM_WRITE ? PAGE_SHARED : PAGE_READONLY);
+	nr_huge_pages++;
+
+	/* a page table may have been dropped */
+	flush_tlb_all();
+
+	return 0;
+}
+
+/*
+ * Update mapped huge pages of a region after a protection change.
+ */
+void change_huge_protection(struct page_directory *pgd, struct vm_area *vma)
+{
+	uint32_t address, idx, pde;
+
+	for (address = vma->vm_start; address < vma->vm_end; address += HPAGE_SIZE) {
+		idx = address >> HPAGE_SHIFT;
+		pde = pgd->tables_physical[idx];
+		if (!(pde & PAGE_PSE))
+			continue;
+
+		pgd->tables_physical[idx] = (pde & HPAGE_MASK) | PAGE_PSE | PAGE_DIRTY
+			| (vma->vm_flags & VM_WRITE ? PAGE_SHARED : PAGE_READONLY);
+	}
+
+	flush_tlb_all();
+}
+
+/*
+ * Copy a huge page (fork).
+ */
+uint32_t clone_huge_page(uint32_t pde)
+{
+	struct page *page;
+	uint32_t i;
+
+	/* get a 4 MB block */
+	page = alloc_pages(HPAGE_ORDER);
+	if (!page)
+		return 0;
+
+	/* copy page */
+	for (i = 0; i < HPAGE_SIZE; i += PAGE_SIZE)
+		copy_page((void *) (PAGE_ADDRESS(page) + i), (void *) (P2V(pde & HPAGE_MASK) + i));
+	nr_huge_pages++;
+
+	return (page->page << PAGE_SHIFT) | PTE_PROT(pde);
+}
+
+/*
+ * Free a huge page.
+ */
+void free_huge_page(uint32_t pde)
+{
+	free_pages(&page_table[pde >> PAGE_SHIFT], HPAGE_ORDER);
+	nr_huge_pages--;
+}
+
+/*
+ * Get the cache line touched in a benchmark page (lines are spread over cache sets).
+ */
+static inline char **tlbbench_line(char **blocks, uint32_t k)
+{
+	return (char **) (blocks[k >> HPAGE_ORDER] + (k & ((1 << HPAGE_ORDER) - 1)) * PAGE_SIZE + ((k >> 5) & 63) * 64);
+}
+
+/*
+ * Chase pointers through one cache line per page of an area (returns cycles per access).
+ */
+static uint32_t tlbbench_run(char **blocks, size_t size)
+{
+	uint32_t nr_pages = size / PAGE_SIZE, low, high, flags, i;
+	uint64_t start, cycles;
+	char **p;
+
+	/* link pages in a pseudo random order (dependent loads defeat prefetching) */
+	for (i = 0; i < nr_pages; i++)
+		*tlbbench_line(blocks, (i * TLBBENCH_MULT) & (nr_pages - 1))
+			= (char *) tlbbench_line(blocks, ((i + 1) * TLBBENCH_MULT) & (nr_pages - 1));
+
+	irq_save(flags);
+
+	/* warm up caches */
+	p = tlbbench_line(blocks, 0);
+	for (i = 0; i < nr_pages; i++)
+		p = *((char ** volatile *) p);
+
+	/* run */
+	rdtsc(low, high);
+	start = ((uint64_t) high << 32) | low;
+	for (i = 0; i < TLBBENCH_PASSES * nr_pages; i++)
+		p = *((char ** volatile *) p);
+	rdtsc(low, high);
+	cycles = (((uint64_t) high << 32) | low) - start;
+
+	irq_restore(flags);
+
+	return cycles / (TLBBENCH_PASSES * nr_pages);
+}
+
+/*
+ * Benchmark TLB reach : same accesses on 4 kB pages (vmalloc) and on 4 MB pages (direct map).
+ */
+int get_tlbbench(char *buf, int count)
+{
+	char *small_blocks[TLBBENCH_BLOCKS], *huge_blocks[TLBBENCH_BLOCKS], *small_area;
+	struct page *pages[TLBBENCH_BLOCKS];
+	int len, huge = 1, nr, i;
+	size_t j;
+
+	/* 4 kB pages area */
+	small_area = vmalloc(TLBBENCH_BLOCKS * HPAGE_SIZE);
+	if (!small_area)
+		return 0;
+
+	/* 4 MB pages areas (direct map uses a 4 MB page for a whole aligned block if PSE is enabled) */
+	for (nr = 0; nr < TLBBENCH_BLOCKS; nr++) {
+		pages[nr] = alloc_pages(HPAGE_ORDER);
+		if (!pages[nr]) {
+			len = 0;
+			goto out;
+		}
+
+		small_blocks[nr] = small_area + nr * HPAGE_SIZE;
+		huge_blocks[nr] = (char *) PAGE_ADDRESS(pages[nr]);
+		if (!(kernel_pgd->tables_physical[(uint32_t) huge_blocks[nr] >> HPAGE_SHIFT] & PAGE_PSE))
+			huge = 0;
+	}
+
+	/* print header */
+	len = sprintf(buf, "pse : %s\n", pse_enabled ? "yes" : "no");
+	len += sprintf(buf + len, "size (kB)\t4k\t4m\t(cycles per access)\n");
+
+	/* run on all working set sizes */
+	for (j = 0; j < sizeof(tlbbench_sizes) / sizeof(tlbbench_sizes[0]) && len < count - 64; j++) {
+		len += sprintf(buf + len, "%d\t%d", tlbbench_sizes[j] / 1024, tlbbench_run(small_blocks, tlbbench_sizes[j]));
+		if (huge)
+			len += sprintf(buf + len, "\t%d\n", tlbbench_run(huge_blocks, tlbbench_sizes[j]));
+		else
+			len += sprintf(buf + len, "\t-\n");
+	}
+
+out:
+	/* free areas */
+	for (i = 0; i < nr; i++)
+		free_pages(pages[i], HPAGE_ORDER);
+	vfree(small_area);
+
+	return len;
+}
@@ -1,6 +1,9 @@
 #include <mm/mm.h>
 #include <mm/paging.h>
 #include <mm/heap.h>
+#include <mm/slab.h>
+#include <mm/mmap.h>
+#include <mm/vmalloc.h>
 #include <fs/fs.h>
 #include <string.h>
 #include <stdio.h>
@@ -11,16 +14,35 @@ uint32_t placement_address = 0;
 /* kernel heap */
 struct heap *kheap = NULL;
 
+/* kmalloc call sites (first slot collects call sites once table is full) */
+static struct kmalloc_site kmalloc_sites[KMALLOC_NR_SITES];
+
 /*
  * Allocate memory (internal function).
  */
 static void *__kmalloc(uint32_t size, uint8_t align)
 {
+	struct kmem_cache *cache;
 	void *ret;
 
 	/* use kernel heap */
-	if (kheap) 
-		return heap_alloc(kheap, size, align);
+	if (kheap) {
+		/* small objects : use slab caches */
+		if (!align) {
+			cache = kmalloc_cache(size);
+			if (cache)
+				return kmem_cache_alloc(cache);
+		}
+
+		/* big or aligned objects : use kernel heap */
+		ret = heap_alloc(kheap, size, align);
+
+		/* kernel heap full : expand big objects in vmalloc area (aligned objects must be identity mapped) */
+		if (!ret && !align)
+			ret = vmalloc(size);
+
+		return ret;
+	}
 
 	/* align adress on PAGE boundary */
 	if (align == 1)
@@ -32,12 +54,96 @@ static void *__kmalloc(uint32_t size, uint8_t align)
 	return ret;
 }
 
+/*
+ * Get the tag slot of a kmalloc object (call site index is stored in allocator private data).
+ */
+static uint16_t *kmalloc_tag(void *p, size_t *size)
+{
+	struct heap_block *block;
+	struct vm_struct *area;
+	uint16_t *tag;
+
+	/* vmalloc object */
+	if (is_vmalloc_addr(p)) {
+		area = find_vm_area(p);
+		if (!area)
+			return NULL;
+
+		*size = area->size - PAGE_SIZE;
+		return &area->tag;
+	}
+
+	/* slab object */
+	tag = kmem_obj_tag(p, size);
+	if (tag)
+		return tag;
+
+	/* heap object */
+	if ((uint32_t) p < kheap->start_address + sizeof(struct heap_block) || (uint32_t) p >= kheap->end_address)
+		return NULL;
+
+	block = (struct heap_block *) ((uint32_t) p - sizeof(struct heap_block));
+	if (block->magic != HEAP_MAGIC)
+		return NULL;
+
+	*size = block->size;
+	return &block->tag;
+}
+
+/*
+ * Get a kmalloc call site index.
+ */
+static uint16_t kmalloc_site_idx(uint32_t caller)
+{
+	uint16_t idx, i;
+
+	/* open addressing on caller address */
+	idx = (caller >> 2) % (KMALLOC_NR_SITES - 1) + 1;
+	for (i = 0; i < KMALLOC_NR_SITES - 1; i++) {
+		if (kmalloc_sites[idx].caller == caller)
+			return idx;
+
+		/* new call site */
+		if (!kmalloc_sites[idx].caller) {
+			kmalloc_sites[idx].caller = caller;
+			return idx;
+		}
+
+		idx = idx % (KMALLOC_NR_SITES - 1) + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Account an allocation to its call site.
+ */
+static void *kmalloc_account(void *p, uint32_t caller)
+{
+	uint16_t *tag;
+	size_t size;
+
+	/* no kernel heap yet : placement allocations are never freed */
+	if (!p || !kheap)
+		return p;
+
+	tag = kmalloc_tag(p, &size);
+	if (!tag)
+		return p;
+
+	*tag = kmalloc_site_idx(caller);
+	kmalloc_sites[*tag].nr_allocs++;
+	kmalloc_sites[*tag].bytes += size;
+
+	return p;
+}
+
 /*
  * Allocate memory.
  */
 void *kmalloc(uint32_t size)
 {
-	return __kmalloc(size, 0);
+	return kmalloc_account(__kmalloc(size, 0), (uint32_t) __builtin_return_address(0));
 }
 
 /*
@@ -45,7 +151,7 @@ void *kmalloc(uint32_t size)
  */
 void *kmalloc_align(uint32_t size)
 {
-	return __kmalloc(size, 1);
+	return kmalloc_account(__kmalloc(size, 1), (uint32_t) __builtin_return_address(0));
 }
 
 /*
@@ -53,10 +159,87 @@ void *kmalloc_align(uint32_t size)
  */
 void kfree(void *p)
 {
+	uint16_t *tag;
+	size_t size;
+
+	if (!p)
+		return;
+
+	/* release object from its call site */
+	if (kheap) {
+		tag = kmalloc_tag(p, &size);
+		if (tag && *tag < KMALLOC_NR_SITES) {
+			kmalloc_sites[*tag].nr_frees++;
+			kmalloc_sites[*tag].bytes -= size;
+		}
+	}
+
+	/* vmalloc object */
+	if (is_vmalloc_addr(p)) {
+		vfree(p);
+		return;
+	}
+
+	/* slab object */
+	if (kmem_free(p) == 0)
+		return;
+
+	/* heap object */
 	if (kheap)
 		heap_free(kheap, p);
 }
 
+/*
+ * Get kernel memory statistics.
+ */
+int get_kmemstat(char *buf, int count)
+{
+	uint16_t sites[KMALLOC_NR_SITES];
+	struct page_usage usage;
+	struct heap_stat stat;
+	int len, nr_sites, i, j;
+
+	/* kernel heap fragmentation */
+	heap_stat(kheap, &stat);
+	len = sprintf(buf, "HeapTotal:\t%d kB\n", kheap->size / 1024);
+	len += sprintf(buf + len, "HeapUsed:\t%d kB (%d blocks)\n", stat.used / 1024, stat.nr_used);
+	len += sprintf(buf + len, "HeapFree:\t%d kB (%d blocks)\n", stat.free / 1024, stat.nr_free);
+	len += sprintf(buf + len, "HeapLargestFree:\t%d kB\n", stat.largest_free / 1024);
+
+	/* pages usage */
+	get_page_usage(&usage);
+	len += sprintf(buf + len, "Cached:\t%d kB\n", usage.cached);
+	len += sprintf(buf + len, "SwapCached:\t%d kB\n", usage.swap_cached);
+	len += sprintf(buf + len, "Buffers:\t%d kB\n", usage.buffers);
+	len += sprintf(buf + len, "Slab:\t%d kB\n", usage.slab);
+	len += sprintf(buf + len, "PageTables:\t%d kB\n", usage.page_tables);
+	len += sprintf(buf + len, "AnonPages:\t%d kB\n", usage.anon);
+	len += sprintf(buf + len, "KernelStack:\t%d kB\n", usage.kernel_stacks);
+
+	/* sort used call sites by allocated bytes (caller 0 = call sites table overflow) */
+	for (i = 0, nr_sites = 0; i < KMALLOC_NR_SITES; i++) {
+		if (!kmalloc_sites[i].nr_allocs)
+			continue;
+
+		for (j = nr_sites++; j > 0 && kmalloc_sites[sites[j - 1]].bytes < kmalloc_sites[i].bytes; j--)
+			sites[j] = sites[j - 1];
+		sites[j] = i;
+	}
+
+	/* print top call sites (keep room for truncation line) */
+	len += sprintf(buf + len, "# caller\tallocs\tfrees\tbytes\n");
+	for (i = 0; i < nr_sites && len < count - 96; i++)
+		len += sprintf(buf + len, "%x\t%d\t%d\t%d\n", kmalloc_sites[sites[i]].caller,
+			       kmalloc_sites[sites[i]].nr_allocs, kmalloc_sites[sites[i]].nr_frees,
+			       kmalloc_sites[sites[i]].bytes);
+
+	/* output truncated */
+	if (i < nr_sites)
+		len += sprintf(buf + len, "# %d more call sites not shown\n", nr_sites - i);
+
+	return len;
+}
+
 /*
  * Init memory paging and kernel heap.
  */
@@ -76,4 +259,19 @@ void init_mem(uint32_t start, uint32_t end)
 	kheap = heap_create(KHEAP_START, KHEAP_SIZE);
 	if (!kheap)
 		panic("Cannot create kernel heap");
+
+	/* init slab allocator */
+	ret = init_slab();
+	if (ret)
+		panic("Cannot init slab allocator");
+
+	/* init vmalloc area */
+	ret = init_vmalloc();
+	if (ret)
+		panic("Cannot init vmalloc area");
+
+	/* create memory regions cache */
+	vm_area_cache = kmem_cache_create("vm_area", sizeof(struct vm_area), NULL);
+	if (!vm_area_cache)
+		panic("Cannot create memory regions cache");
 }
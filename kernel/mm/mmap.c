@@ -1,10 +1,14 @@
 #include <mm/mmap.h>
 #include <mm/mm.h>
+#include <mm/swap.h>
 #include <proc/sched.h>
 #include <stdio.h>
 #include <stderr.h>
 #include <fcntl.h>
 
+/* memory regions cache */
+struct kmem_cache *vm_area_cache = NULL;
+
 /*
  * Page protection.
  */
@@ -14,22 +18,219 @@ uint32_t protection_map[16] = {
 };
 
 /*
- * Find a memory region.
+ * Get start of free gap before a memory region (only user memory map is considered).
  */
-struct vm_area *find_vma(struct task *task, uint32_t addr)
+static uint32_t vma_gap_start(struct vm_area *vm)
+{
+	struct vm_area *vm_prev;
+
+	/* first memory region */
+	if (vm->list.prev == &vm->vm_mm->vm_list)
+		return UMAP_START;
+
+	vm_prev = list_entry(vm->list.prev, struct vm_area, list);
+	return vm_prev->vm_end > UMAP_START ? vm_prev->vm_end : UMAP_START;
+}
+
+/*
+ * Get size of free gap before a memory region.
+ */
+static uint32_t vma_gap(struct vm_area *vm)
+{
+	uint32_t start = vma_gap_start(vm);
+	uint32_t end = vm->vm_start < UMAP_END ? vm->vm_start : UMAP_END;
+
+	return end > start ? end - start : 0;
+}
+
+/*
+ * Compute largest free gap of a subtree.
+ */
+static uint32_t vma_compute_subtree_gap(struct vm_area *vm)
+{
+	uint32_t max = vma_gap(vm), gap;
+
+	if (vm->rb.rb_left) {
+		gap = rb_entry(vm->rb.rb_left, struct vm_area, rb)->rb_subtree_gap;
+		if (gap > max)
+			max = gap;
+	}
+
+	if (vm->rb.rb_right) {
+		gap = rb_entry(vm->rb.rb_right, struct vm_area, rb)->rb_subtree_gap;
+		if (gap > max)
+			max = gap;
+	}
+
+	return max;
+}
+
+/*
+ * Propagate largest free gap up to stop node.
+ */
+static void vma_gap_propagate(struct rb_node *node, struct rb_node *stop)
 {
-	struct list_head *pos;
 	struct vm_area *vm;
+	uint32_t gap;
 
-	list_for_each(pos, &task->mm->vm_list) {
-		vm = list_entry(pos, struct vm_area, list);
-		if (addr < vm->vm_start)
+	while (node != stop) {
+		vm = rb_entry(node, struct vm_area, rb);
+		gap = vma_compute_subtree_gap(vm);
+		if (vm->rb_subtree_gap == gap)
 			break;
-		if (addr < vm->vm_end)
-			return vm;
+
+		vm->rb_subtree_gap = gap;
+		node = node->rb_parent;
 	}
+}
 
-	return NULL;
+/*
+ * Copy largest free gap (erase).
+ */
+static void vma_gap_copy(struct rb_node *old, struct rb_node *new)
+{
+	rb_entry(new, struct vm_area, rb)->rb_subtree_gap = rb_entry(old, struct vm_area, rb)->rb_subtree_gap;
+}
+
+/*
+ * Update largest free gap (rotation).
+ */
+static void vma_gap_rotate(struct rb_node *old, struct rb_node *new)
+{
+	struct vm_area *vm_old = rb_entry(old, struct vm_area, rb);
+	struct vm_area *vm_new = rb_entry(new, struct vm_area, rb);
+
+	vm_new->rb_subtree_gap = vm_old->rb_subtree_gap;
+	vm_old->rb_subtree_gap = vma_compute_subtree_gap(vm_old);
+}
+
+/*
+ * Memory regions tree callbacks.
+ */
+static const struct rb_augment_callbacks vma_gap_callbacks = {
+	.propagate	= vma_gap_propagate,
+	.copy		= vma_gap_copy,
+	.rotate		= vma_gap_rotate,
+};
+
+/*
+ * Update free gaps after a memory region bounds change (gap after the region belongs to next region).
+ */
+void vma_gap_update(struct vm_area *vm)
+{
+	struct vm_area *vm_next;
+
+	vma_gap_propagate(&vm->rb, NULL);
+
+	vm_next = list_next_entry_or_null(vm, &vm->vm_mm->vm_list, list);
+	if (vm_next)
+		vma_gap_propagate(&vm_next->rb, NULL);
+}
+
+/*
+ * Insert a memory region (region must not overlap existing ones).
+ */
+void vma_link(struct mm_struct *mm, struct vm_area *vm)
+{
+	struct rb_node **link = &mm->vm_rb.rb_node, *parent = NULL;
+	struct vm_area *vm_prev = NULL, *tmp;
+
+	/* find position in tree */
+	while (*link) {
+		parent = *link;
+		tmp = rb_entry(parent, struct vm_area, rb);
+
+		if (vm->vm_start < tmp->vm_start) {
+			link = &parent->rb_left;
+		} else {
+			vm_prev = tmp;
+			link = &parent->rb_right;
+		}
+	}
+
+	/* add it to the list */
+	vm->vm_mm = mm;
+	if (vm_prev)
+		list_add(&vm->list, &vm_prev->list);
+	else
+		list_add(&vm->list, &mm->vm_list);
+
+	/* add it to the tree */
+	rb_link_node(&vm->rb, parent, link);
+	vm->rb_subtree_gap = 0;
+	vma_gap_propagate(&vm->rb, NULL);
+	rb_insert_augmented(&vm->rb, &mm->vm_rb, &vma_gap_callbacks);
+
+	/* gap of next region shrinked */
+	vma_gap_update(vm);
+}
+
+/*
+ * Remove a memory region.
+ */
+void vma_unlink(struct vm_area *vm)
+{
+	struct mm_struct *mm = vm->vm_mm;
+	struct vm_area *vm_next;
+
+	/* remove it from tree and list */
+	vm_next = list_next_entry_or_null(vm, &mm->vm_list, list);
+	rb_erase_augmented(&vm->rb, &mm->vm_rb, &vma_gap_callbacks);
+	list_del(&vm->list);
+
+	/* gap of next region grew */
+	if (vm_next)
+		vma_gap_propagate(&vm_next->rb, NULL);
+
+	/* invalidate cache */
+	if (mm->vm_cache == vm)
+		mm->vm_cache = NULL;
+}
+
+/*
+ * Find first memory region ending after addr.
+ */
+static struct vm_area *__find_vma(struct mm_struct *mm, uint32_t addr)
+{
+	struct rb_node *node = mm->vm_rb.rb_node;
+	struct vm_area *vm, *res = NULL;
+
+	while (node) {
+		vm = rb_entry(node, struct vm_area, rb);
+
+		if (addr < vm->vm_end) {
+			res = vm;
+			if (addr >= vm->vm_start)
+				break;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	return res;
+}
+
+/*
+ * Find a memory region.
+ */
+struct vm_area *find_vma(struct task *task, uint32_t addr)
+{
+	struct mm_struct *mm = task->mm;
+	struct vm_area *vm;
+
+	/* check last found region first (faults tend to hit the same region) */
+	vm = mm->vm_cache;
+	if (vm && addr >= vm->vm_start && addr < vm->vm_end)
+		return vm;
+
+	/* lookup tree */
+	vm = __find_vma(mm, addr);
+	if (!vm || addr < vm->vm_start)
+		return NULL;
+
+	mm->vm_cache = vm;
+	return vm;
 }
 
 /*
@@ -37,15 +238,18 @@ struct vm_area *find_vma(struct task *task, uint32_t addr)
  */
 struct vm_area *find_vma_prev(struct task *task, uint32_t addr)
 {
+	struct rb_node *node = task->mm->vm_rb.rb_node;
 	struct vm_area *vm, *vm_prev = NULL;
-	struct list_head *pos;
 
-	list_for_each(pos, &task->mm->vm_list) {
-		vm = list_entry(pos, struct vm_area, list);
-		if (addr < vm->vm_end)
-			break;
+	while (node) {
+		vm = rb_entry(node, struct vm_area, rb);
 
-		vm_prev = vm;
+		if (addr < vm->vm_end) {
+			node = node->rb_left;
+		} else {
+			vm_prev = vm;
+			node = node->rb_right;
+		}
 	}
 
 	return vm_prev;
@@ -56,34 +260,33 @@ struct vm_area *find_vma_prev(struct task *task, uint32_t addr)
  */
 struct vm_area *find_vma_next(struct task *task, uint32_t addr)
 {
-	struct list_head *pos;
-	struct vm_area *vm;
+	struct rb_node *node = task->mm->vm_rb.rb_node;
+	struct vm_area *vm, *vm_next = NULL;
+
+	while (node) {
+		vm = rb_entry(node, struct vm_area, rb);
 
-	list_for_each(pos, &task->mm->vm_list) {
-		vm = list_entry(pos, struct vm_area, list);
-		if (addr < vm->vm_start)
-			return vm;
+		if (addr < vm->vm_start) {
+			vm_next = vm;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
 	}
 
-	return NULL;
+	return vm_next;
 }
+
 /*
  * Find first vm intersecting start <-> end.
  */
 struct vm_area *find_vma_intersection(struct task *task, uint32_t start, uint32_t end)
 {
-	struct vm_area *vm_prev, *vm_next = NULL;
-
-	/* find previous and next vma */
-	vm_prev = find_vma_prev(task, start);
-	if (vm_prev)
-		vm_next = list_next_entry_or_null(vm_prev, &task->mm->vm_list, list);
-	else if (!list_empty(&task->mm->vm_list))
-		vm_next = list_first_entry(&task->mm->vm_list, struct vm_area, list);
+	struct vm_area *vm;
 
-	/* check next vma */
-	if (vm_next && end > vm_next->vm_start)
-		return vm_next;
+	vm = __find_vma(task->mm, start);
+	if (vm && end > vm->vm_start)
+		return vm;
 
 	return NULL;
 }
@@ -93,11 +296,11 @@ struct vm_area *find_vma_intersection(struct task *task, uint32_t start, uint32_
  */
 static struct vm_area *generic_mmap(uint32_t addr, size_t len, int prot, int flags, struct file *filp, off_t offset)
 {
-	struct vm_area *vm, *vm_prev;
+	struct vm_area *vm;
 	int ret;
 
 	/* create new memory region */
-	vm = (struct vm_area *) kmalloc(sizeof(struct vm_area));
+	vm = (struct vm_area *) kmem_cache_alloc(vm_area_cache);
 	if (!vm)
 		return NULL;
 
@@ -107,6 +310,8 @@ static struct vm_area *generic_mmap(uint32_t addr, size_t len, int prot, int fla
 	vm->vm_end = addr + len;
 	vm->vm_flags = prot & (VM_READ | VM_WRITE | VM_EXEC);
 	vm->vm_flags |= flags & (VM_GROWSDOWN | VM_DENYWRITE | VM_EXECUTABLE);
+	if (flags & MAP_HUGETLB)
+		vm->vm_flags |= VM_HUGETLB;
 	vm->vm_page_prot = protection_map[vm->vm_flags & 0x0F];
 	vm->vm_offset = offset;
 	vm->vm_inode = NULL;
@@ -130,16 +335,12 @@ static struct vm_area *generic_mmap(uint32_t addr, size_t len, int prot, int fla
 		list_add_tail(&vm->list_share, &filp->f_inode->i_mmap);
 	}
 
-	/* add it to the list */
-	vm_prev = find_vma_prev(current_task, vm->vm_start);
-	if (vm_prev)
-		list_add(&vm->list, &vm_prev->list);
-	else
-		list_add(&vm->list, &current_task->mm->vm_list);
+	/* add it to the list and tree */
+	vma_link(current_task->mm, vm);
 
 	return vm;
 err:
-	kfree(vm);
+	kmem_cache_free(vm_area_cache, vm);
 	return NULL;
 }
 
@@ -148,44 +349,63 @@ err:
  */
 static int get_unmapped_area(uint32_t *addr, size_t len, int flags)
 {
-	struct vm_area *vm, *vm_prev, *vm_next = NULL;
-	struct list_head *pos;
+	uint32_t align = flags & MAP_HUGETLB ? HPAGE_SIZE : PAGE_SIZE;
+	struct mm_struct *mm = current_task->mm;
+	struct rb_node *node;
+	struct vm_area *vm;
+	size_t gap_len;
 
 	/* fixed address */
 	if (flags & MAP_FIXED) {
-		if (*addr & ~PAGE_MASK)
+		if (*addr & (align - 1))
 			return -EINVAL;
 		return 0;
 	}
 
 	/* try to use addr */
 	if (*addr) {
-		*addr = PAGE_ALIGN_UP(*addr);
-
-		/* find previous and next vm */
-		vm_prev = find_vma_prev(current_task, *addr);
-		if (vm_prev)
-			vm_next = list_next_entry_or_null(vm_prev, &current_task->mm->vm_list, list);
-		else if (!list_empty(&current_task->mm->vm_list))
-			vm_next = list_first_entry(&current_task->mm->vm_list, struct vm_area, list);
+		*addr = ALIGN_UP(*addr, align);
 
 		/* addr is available */
-		if (!vm_next || *addr + len <= vm_next->vm_start)
+		vm = __find_vma(mm, *addr);
+		if (!vm || *addr + len <= vm->vm_start)
 			return 0;
 	}
 
-	/* find a memory region */
+	/* any gap of gap_len bytes can hold an aligned area */
+	gap_len = len + align - PAGE_SIZE;
+
+	/* find lowest gap big enough (each node knows the largest gap of its subtree) */
+	node = mm->vm_rb.rb_node;
+	if (node && rb_entry(node, struct vm_area, rb)->rb_subtree_gap >= gap_len) {
+		vm = rb_entry(node, struct vm_area, rb);
+
+		for (;;) {
+			if (vm->rb.rb_left && rb_entry(vm->rb.rb_left, struct vm_area, rb)->rb_subtree_gap >= gap_len)
+				vm = rb_entry(vm->rb.rb_left, struct vm_area, rb);
+			else if (vma_gap(vm) >= gap_len)
+				break;
+			else
+				vm = rb_entry(vm->rb.rb_right, struct vm_area, rb);
+		}
+
+		*addr = ALIGN_UP(vma_gap_start(vm), align);
+		return 0;
+	}
+
+	/* else map after last region */
 	*addr = UMAP_START;
-	list_for_each(pos, &current_task->mm->vm_list) {
-		vm = list_entry(pos, struct vm_area, list);
-		if (*addr + len <= vm->vm_start)
-			break;
+	if (!list_empty(&mm->vm_list)) {
+		vm = list_entry(mm->vm_list.prev, struct vm_area, list);
 		if (vm->vm_end > *addr)
 			*addr = vm->vm_end;
 	}
 
 	/* check memory map overflow */
-	if (*addr + len >= UMAP_END)
+	if (*addr >= UMAP_END)
+		return -ENOMEM;
+	*addr = ALIGN_UP(*addr, align);
+	if (*addr >= UMAP_END || UMAP_END - *addr < len)
 		return -ENOMEM;
 
 	return 0;
@@ -206,6 +426,13 @@ void *do_mmap(uint32_t addr, size_t len, int prot, int flags, struct file *filp,
 	if (filp && (!filp->f_op || !filp->f_op->mmap))
 		return NULL;
 
+	/* huge pages : private anonymous mappings only, 4 MB aligned */
+	if (flags & MAP_HUGETLB) {
+		if (filp || !pse_enabled)
+			return NULL;
+		len = ALIGN_UP(len, HPAGE_SIZE);
+	}
+
 	/* adjust length */
 	len = PAGE_ALIGN_UP(len);
 	if (len == 0)
@@ -236,20 +463,22 @@ static int unmap_fixup(struct vm_area *vm, uint32_t addr, size_t len)
 		if (vm->vm_ops && vm->vm_ops->close)
 			vm->vm_ops->close(vm);
 
-		list_del(&vm->list);
-		kfree(vm);
+		vma_unlink(vm);
+		kmem_cache_free(vm_area_cache, vm);
 		return 0;
 	}
 
 	/* shrink area or create a hole */
 	if (end == vm->vm_end) {
 		vm->vm_end = addr;
+		vma_gap_update(vm);
 	} else if (addr == vm->vm_start) {
 		vm->vm_offset += (end - vm->vm_start);
 		vm->vm_start = end;
+		vma_gap_update(vm);
 	} else {
 		/* create new memory region */
-		vm_new = (struct vm_area *) kmalloc(sizeof(struct vm_area));
+		vm_new = (struct vm_area *) kmem_cache_alloc(vm_area_cache);
 		if (!vm_new)
 			return -ENOMEM;
 
@@ -267,11 +496,12 @@ static int unmap_fixup(struct vm_area *vm, uint32_t addr, size_t len)
 		if (vm_new->vm_ops && vm_new->vm_ops->open)
 			vm_new->vm_ops->open(vm_new);
 
-		/* add new memory region after old one */
-		list_add(&vm_new->list, &vm->list);
-
 		/* update old memory region */
 		vm->vm_end = addr;
+		vma_gap_update(vm);
+
+		/* add new memory region after old one */
+		vma_link(vm->vm_mm, vm_new);
 	}
 
 	return 0;
@@ -282,8 +512,8 @@ static int unmap_fixup(struct vm_area *vm, uint32_t addr, size_t len)
  */
 int do_munmap(uint32_t addr, size_t len)
 {
-	struct list_head *pos, *n;
-	struct vm_area *vm;
+	struct mm_struct *mm = current_task->mm;
+	struct vm_area *vm, *vm_next;
 	uint32_t start, end;
 
 	/* add must be page aligned */
@@ -293,13 +523,14 @@ int do_munmap(uint32_t addr, size_t len)
 	/* adjust length */
 	len = PAGE_ALIGN_UP(len);
 
+	/* huge page regions can only be unmapped by 4 MB blocks */
+	for (vm = __find_vma(mm, addr); vm && addr + len > vm->vm_start; vm = list_next_entry_or_null(vm, &mm->vm_list, list))
+		if ((vm->vm_flags & VM_HUGETLB) && ((addr | len) & ~HPAGE_MASK))
+			return -EINVAL;
+
 	/* find regions to unmap */
-	list_for_each_safe(pos, n, &current_task->mm->vm_list) {
-		vm = list_entry(pos, struct vm_area, list);
-		if (addr >= vm->vm_end)
-			continue;
-		if (addr + len <= vm->vm_start)
-			break;
+	for (vm = __find_vma(mm, addr); vm && addr + len > vm->vm_start; vm = vm_next) {
+		vm_next = list_next_entry_or_null(vm, &mm->vm_list, list);
 
 		/* compute area to unmap */
 		start = addr < vm->vm_start ? vm->vm_start : addr;
@@ -310,7 +541,7 @@ int do_munmap(uint32_t addr, size_t len)
 	}
 
 	/* unmap region */
-	unmap_pages(addr, addr + len, current_task->mm->pgd);
+	unmap_pages(addr, addr + len, mm->pgd);
 
 	return 0;
 }
@@ -320,7 +551,7 @@ int do_munmap(uint32_t addr, size_t len)
  */
 void *do_mremap(uint32_t old_address, size_t old_size, size_t new_size, int flags, uint32_t new_address)
 {
-	struct vm_area *vma, *vma_next;
+	struct vm_area *vma, *vma_next, *vma_new;
 	int ret;
 
 	/* check flags */
@@ -368,6 +599,9 @@ void *do_mremap(uint32_t old_address, size_t old_size, size_t new_size, int flag
 		/* done */
 		if (!(flags & MREMAP_FIXED) || new_address == old_address)
 			return (void *) old_address;
+
+		/* move remaining pages */
+		old_size = new_size;
 	}
 
 	/* find old memory region */
@@ -379,6 +613,10 @@ void *do_mremap(uint32_t old_address, size_t old_size, size_t new_size, int flag
 	if (old_size > vma->vm_end - old_address)
 		return NULL;
 
+	/* huge page regions can't be remapped */
+	if (vma->vm_flags & VM_HUGETLB)
+		return NULL;
+
 	/* try to grow old region */
 	if (old_size == vma->vm_end - old_address
 		&& !(flags & MREMAP_FIXED)
@@ -387,15 +625,52 @@ void *do_mremap(uint32_t old_address, size_t old_size, size_t new_size, int flag
 			/* get next vma */
 			vma_next = list_next_entry_or_null(vma, &current_task->mm->vm_list, list);
 
-			/* just expand old region */
-			if (!vma_next || vma_next->vm_start - old_address >= new_size) {
+			/* just expand old region (following gap is free) */
+			if (old_address + new_size > old_address && (!vma_next || vma_next->vm_start - old_address >= new_size)) {
 				vma->vm_end = old_address + new_size;
+				vma_gap_update(vma);
 				return (void *) old_address;
 			}
 	}
 
-	/* TODO : move memory region into a new one */
-	printf("mremap not implemented\n");
+	/* region must be moved */
+	if (!(flags & MREMAP_MAYMOVE))
+		goto err;
+
+	/* get new area */
+	if (!(flags & MREMAP_FIXED)) {
+		new_address = 0;
+		if (get_unmapped_area(&new_address, new_size, 0))
+			goto err;
+	}
+
+	/* create new memory region */
+	vma_new = (struct vm_area *) kmem_cache_alloc(vm_area_cache);
+	if (!vma_new)
+		goto err;
+
+	/* set new memory region */
+	*vma_new = *vma;
+	vma_new->vm_start = new_address;
+	vma_new->vm_end = new_address + new_size;
+	vma_new->vm_offset = vma->vm_offset + (old_address - vma->vm_start);
+	if (vma_new->vm_ops && vma_new->vm_ops->open)
+		vma_new->vm_ops->open(vma_new);
+
+	/* move page table entries (no data copy) */
+	ret = move_page_tables(current_task->mm->pgd, old_address, new_address, old_size);
+	if (ret) {
+		if (vma_new->vm_ops && vma_new->vm_ops->close)
+			vma_new->vm_ops->close(vma_new);
+		kmem_cache_free(vm_area_cache, vma_new);
+		goto err;
+	}
+
+	/* add new region and unmap old one (its page table entries are empty now) */
+	vma_link(current_task->mm, vma_new);
+	do_munmap(old_address, old_size);
+
+	return (void *) new_address;
 err:
 	return NULL;
 }
@@ -403,29 +678,32 @@ err:
 /*
  * Change memory protection.
  */
-static int mprotect_fixup_all(struct vm_area *vm, uint16_t newflags, uint32_t newprot)
+static int mprotect_fixup_all(struct vm_area *vm, uint32_t newflags, uint32_t newprot)
 {
 	vm->vm_flags = newflags;
 	vm->vm_page_prot = newprot;
+
+	/* huge pages are mapped writable on fault only if region is writable : update them */
+	if (vm->vm_flags & VM_HUGETLB)
+		change_huge_protection(vm->vm_mm->pgd, vm);
+
 	return 0;
 }
 
 /*
  * Change memory protection (start of vm).
  */
-static int mprotect_fixup_start(struct vm_area *vm, uint32_t end, uint16_t newflags, uint32_t newprot)
+static int mprotect_fixup_start(struct vm_area *vm, uint32_t end, uint32_t newflags, uint32_t newprot)
 {
 	struct vm_area *vm_new;
 
 	/* create new memory region */
-	vm_new = (struct vm_area *) kmalloc(sizeof(struct vm_area));
+	vm_new = (struct vm_area *) kmem_cache_alloc(vm_area_cache);
 	if (!vm_new)
 		return -ENOMEM;
 
 	/* set new memory region */
 	*vm_new = *vm;
-	if (vm_new->vm_inode)
-		vm_new->vm_inode->i_ref++;
 	vm_new->vm_flags = newflags;
 	vm_new->vm_page_prot = newprot;
 
@@ -433,9 +711,12 @@ static int mprotect_fixup_start(struct vm_area *vm, uint32_t end, uint16_t newfl
 	vm_new->vm_end = end;
 	vm->vm_start = end;
 	vm->vm_offset += vm->vm_start - vm_new->vm_start;
+	vma_gap_update(vm);
 
-	/* add new memory region before old one */
-	list_add_tail(&vm_new->list, &vm->list);
+	/* add new memory region before old one and open it (inode reference and shared mappings list) */
+	vma_link(vm->vm_mm, vm_new);
+	if (vm_new->vm_ops && vm_new->vm_ops->open)
+		vm_new->vm_ops->open(vm_new);
 
 	return 0;
 }
@@ -443,19 +724,17 @@ static int mprotect_fixup_start(struct vm_area *vm, uint32_t end, uint16_t newfl
 /*
  * Change memory protection (end of vm).
  */
-static int mprotect_fixup_end(struct vm_area *vm, uint32_t start, uint16_t newflags, uint32_t newprot)
+static int mprotect_fixup_end(struct vm_area *vm, uint32_t start, uint32_t newflags, uint32_t newprot)
 {
 	struct vm_area *vm_new;
 
 	/* create new memory region */
-	vm_new = (struct vm_area *) kmalloc(sizeof(struct vm_area));
+	vm_new = (struct vm_area *) kmem_cache_alloc(vm_area_cache);
 	if (!vm_new)
 		return -ENOMEM;
 
 	/* set new memory region */
 	*vm_new = *vm;
-	if (vm_new->vm_inode)
-		vm_new->vm_inode->i_ref++;
 	vm_new->vm_flags = newflags;
 	vm_new->vm_page_prot = newprot;
 
@@ -463,9 +742,12 @@ static int mprotect_fixup_end(struct vm_area *vm, uint32_t start, uint16_t newfl
 	vm->vm_end = start;
 	vm_new->vm_start = start;
 	vm_new->vm_offset += vm_new->vm_start - vm->vm_start;
+	vma_gap_update(vm);
 
-	/* add new memory region after old one */
-	list_add(&vm_new->list, &vm->list);
+	/* add new memory region after old one and open it (inode reference and shared mappings list) */
+	vma_link(vm->vm_mm, vm_new);
+	if (vm_new->vm_ops && vm_new->vm_ops->open)
+		vm_new->vm_ops->open(vm_new);
 
 	return 0;
 }
@@ -473,21 +755,59 @@ static int mprotect_fixup_end(struct vm_area *vm, uint32_t start, uint16_t newfl
 /*
  * Change memory protection (middle of vm).
  */
-static int mprotect_fixup_middle(struct vm_area *vm, uint32_t start, uint32_t end, uint16_t newflags, uint32_t newprot)
+static int mprotect_fixup_middle(struct vm_area *vm, uint32_t start, uint32_t end, uint32_t newflags, uint32_t newprot)
 {
-	UNUSED(vm);
-	UNUSED(start);
-	UNUSED(end);
-	UNUSED(newflags);
-	UNUSED(newprot);
-	printf("mprotect_fixup_middle() not implemented\n");
-	return -EINVAL;
+	struct vm_area *vm_new;
+	int ret;
+
+	/* split end of region (keep old protection) */
+	ret = mprotect_fixup_end(vm, start, vm->vm_flags, vm->vm_page_prot);
+	if (ret)
+		return ret;
+
+	/* change protection of new region start (it follows old region) */
+	vm_new = list_next_entry(vm, list);
+	return mprotect_fixup_start(vm_new, end, newflags, newprot);
+}
+
+/*
+ * Merge adjacent memory regions with the same attributes around [start, end] (undo splits).
+ */
+static void vma_merge_range(struct mm_struct *mm, uint32_t start, uint32_t end)
+{
+	struct vm_area *vm, *next;
+
+	/* start from region before range (it may merge with first region of range), else from first region of range */
+	vm = __find_vma(mm, start ? start - 1 : 0);
+
+	while (vm && vm->vm_start < end) {
+		next = list_next_entry_or_null(vm, &mm->vm_list, list);
+		if (!next || next->vm_start > end)
+			break;
+
+		/* different regions */
+		if (vm->vm_end != next->vm_start || vm->vm_flags != next->vm_flags
+				|| vm->vm_page_prot != next->vm_page_prot || vm->vm_inode != next->vm_inode
+				|| vm->vm_ops != next->vm_ops || (vm->vm_flags & VM_HUGETLB)
+				|| (vm->vm_inode && vm->vm_offset + vm->vm_end - vm->vm_start != next->vm_offset)) {
+			vm = next;
+			continue;
+		}
+
+		/* extend region and release next one */
+		vma_unlink(next);
+		vm->vm_end = next->vm_end;
+		vma_gap_update(vm);
+		if (next->vm_ops && next->vm_ops->close)
+			next->vm_ops->close(next);
+		kmem_cache_free(vm_area_cache, next);
+	}
 }
 
 /*
  * Change memory protection (split memory region if needed).
  */
-static int mprotect_fixup(struct vm_area *vm, uint32_t start, uint32_t end, uint16_t newflags)
+static int mprotect_fixup(struct vm_area *vm, uint32_t start, uint32_t end, uint32_t newflags)
 {
 	uint32_t newprot;
 	int ret;
@@ -496,6 +816,10 @@ static int mprotect_fixup(struct vm_area *vm, uint32_t start, uint32_t end, uint
 	if (vm->vm_flags == newflags)
 		return 0;
 
+	/* huge page regions can't be split */
+	if ((vm->vm_flags & VM_HUGETLB) && (vm->vm_start != start || vm->vm_end != end))
+		return -EINVAL;
+
 	/* get new protection */
 	newprot = protection_map[newflags & 0x0F];
 
@@ -519,7 +843,7 @@ int do_mprotect(uint32_t start, size_t size, int prot)
 {
 	struct vm_area *vm, *next;
 	uint32_t nstart, end, tmp;
-	uint16_t newflags;
+	uint32_t newflags;
 	int ret = 0;
 
 	/* address must be page aligned */
@@ -576,6 +900,9 @@ int do_mprotect(uint32_t start, size_t size, int prot)
 		}
 	}
 
+	/* merge regions split by protection changes */
+	vma_merge_range(current_task->mm, start, end);
+
 	return ret;
 }
 
@@ -584,7 +911,8 @@ int do_mprotect(uint32_t start, size_t size, int prot)
  */
 void vmtruncate(struct inode *inode, off_t offset)
 {
-	UNUSED(offset);
+	/* truncate page cache (before file system frees blocks) */
+	truncate_inode_pages(inode, offset);
 
 	if (!list_empty(&inode->i_mmap))
 		printf("vmtruncate() not implemented");
@@ -642,15 +970,102 @@ void *sys_mremap(void *old_address, size_t old_size, size_t new_size, int flags,
 	return do_mremap((uint32_t) old_address, old_size, new_size, flags, (uint32_t) new_address);
 }
 
+/*
+ * Apply an advice on a part of a memory region.
+ */
+static int madvise_vma(struct vm_area *vm, uint32_t start, uint32_t end, int advice)
+{
+	uint32_t newflags;
+
+	switch (advice) {
+		case MADV_NORMAL:
+		case MADV_RANDOM:
+		case MADV_SEQUENTIAL:
+			/* set expected access pattern (used by fault around) */
+			newflags = vm->vm_flags & ~(VM_SEQ_READ | VM_RAND_READ);
+			if (advice == MADV_RANDOM)
+				newflags |= VM_RAND_READ;
+			else if (advice == MADV_SEQUENTIAL)
+				newflags |= VM_SEQ_READ;
+
+			return mprotect_fixup(vm, start, end, newflags);
+		case MADV_WILLNEED:
+			/* read file pages into page cache */
+			if (vm->vm_inode)
+				page_cache_readahead(vm->vm_inode, start - vm->vm_start + vm->vm_offset, end - start);
+
+			return 0;
+		case MADV_FREE:
+			/* only private anonymous pages can be discarded */
+			if (vm->vm_inode || (vm->vm_flags & VM_SHARED))
+				return -EINVAL;
+
+			/* fall through */
+		case MADV_DONTNEED:
+			/* locked pages can't be dropped and huge pages can only be dropped as a whole */
+			if (vm->vm_flags & VM_LOCKED)
+				return -EINVAL;
+			if ((vm->vm_flags & VM_HUGETLB) && ((start | end) & ~HPAGE_MASK))
+				return -EINVAL;
+
+			/* drop pages (and swap entries) : next access will fault them in again */
+			unmap_pages(start, end, vm->vm_mm->pgd);
+			return 0;
+		default:
+			return -EINVAL;
+	}
+}
+
 /*
  * Madvise system call.
  */
 int sys_madvise(void *addr, size_t length, int advice)
 {
-	UNUSED(addr);
-	UNUSED(length);
-	UNUSED(advice);
-	return 0;
+	uint32_t start = (uint32_t) addr, end, nstart, tmp;
+	struct vm_area *vm, *next;
+	int ret;
+
+	/* address must be page aligned */
+	if (start & ~PAGE_MASK)
+		return -EINVAL;
+
+	/* compute end address */
+	end = start + PAGE_ALIGN_UP(length);
+	if (end < start)
+		return -EINVAL;
+
+	/* empty region */
+	if (end == start)
+		return 0;
+
+	/* find first memory region */
+	vm = find_vma(current_task, start);
+	if (!vm)
+		return -ENOMEM;
+
+	/* apply advice on all memory regions */
+	for (nstart = start;;) {
+		tmp = vm->vm_end < end ? vm->vm_end : end;
+		next = list_next_entry_or_null(vm, &current_task->mm->vm_list, list);
+		ret = madvise_vma(vm, nstart, tmp, advice);
+		if (ret || tmp == end)
+			break;
+
+		/* go to next memory region */
+		nstart = tmp;
+		vm = next;
+
+		/* hole or no more regions */
+		if (!vm || vm->vm_start != nstart) {
+			ret = -ENOMEM;
+			break;
+		}
+	}
+
+	/* merge regions split by access pattern changes */
+	vma_merge_range(current_task->mm, start, end);
+
+	return ret;
 }
 
 /*
@@ -699,13 +1114,60 @@ out:
 	return current_task->mm->end_brk;
 }
 
+/*
+ * Is a page resident in memory ?
+ */
+static unsigned char mincore_page(struct vm_area *vm, uint32_t address)
+{
+	struct page_directory *pgd = vm->vm_mm->pgd;
+	uint32_t idx = address >> HPAGE_SHIFT, pte;
+
+	/* huge page */
+	if (pgd->tables_physical[idx] & PAGE_PSE)
+		return 1;
+
+	/* mapped page or swapped page still in swap cache */
+	if (pgd->tables[idx]) {
+		pte = pgd->tables[idx]->pages[(address >> PAGE_SHIFT) & 0x3FF];
+		if (pte & PAGE_PRESENT)
+			return 1;
+		if (PTE_SWAP(pte))
+			return in_swap_cache(pte);
+	}
+
+	/* not mapped yet : file page may be cached */
+	if (vm->vm_inode)
+		return __find_page(vm->vm_inode, address - vm->vm_start + vm->vm_offset) != NULL;
+
+	return 0;
+}
+
 /*
  * Determine wether pages are resident in memory.
  */
 int sys_mincore(void *addr, size_t len, unsigned char *vec)
 {
-	UNUSED(addr);
-	UNUSED(len);
-	UNUSED(vec);
+	uint32_t start = (uint32_t) addr, end, address;
+	struct vm_area *vm;
+	size_t i;
+
+	/* address must be page aligned */
+	if (start & ~PAGE_MASK)
+		return -EINVAL;
+
+	/* compute end address */
+	end = start + PAGE_ALIGN_UP(len);
+	if (end < start)
+		return -ENOMEM;
+
+	/* check pages */
+	for (address = start, i = 0; address < end; address += PAGE_SIZE, i++) {
+		vm = find_vma(current_task, address);
+		if (!vm)
+			return -ENOMEM;
+
+		vec[i] = mincore_page(vm, address);
+	}
+
 	return 0;
 }
@@ -1,7 +1,13 @@
 #include <mm/mm.h>
+#include <mm/mmap.h>
 #include <proc/sched.h>
 #include <mm/paging.h>
+#include <mm/slab.h>
+#include <mm/swap.h>
 #include <sys/syscall.h>
+#include <kernel_stat.h>
+#include <x86/system.h>
+#include <x86/fpu.h>
 #include <stdio.h>
 #include <string.h>
 #include <stderr.h>
@@ -9,69 +15,330 @@
 /* global pages */
 uint32_t nr_pages;
 struct page *page_table;
-static struct list_head free_pages;
+static struct free_area free_area[MAX_ORDER];
+static uint32_t nr_free = 0;
 static struct list_head used_pages;
+static LIST_HEAD(zero_pages);
+uint32_t nr_zero_pages = 0;
+static uint32_t zero_pages_high = 0;
+static uint32_t nr_page_tables = 0;
+
+/* number of anonymous user pages */
+static uint32_t nr_anon_pages = 0;
 static int page_htable_bits = 0;
 static struct htable_link **page_htable = NULL;
 
 /* page directories */
 struct page_directory *kernel_pgd = NULL;
+struct page_directory *current_pgd = NULL;
+
+/* 4 MB pages support */
+uint8_t pse_enabled = 0;
+
+/* SSE2 page copy/clear */
+uint8_t sse2_enabled = 0;
+
+/* shared zero page (mapped by read faults on anonymous memory) */
+struct page *zero_page = NULL;
 
-/* copy phsyical page (defined in x86/paging.s) */
-extern void copy_page_physical(uint32_t src, uint32_t dst);
+/* number of cached file pages mapped around a faulting address */
+uint32_t fault_around_pages = FAULT_AROUND_PAGES;
+
+/* kernel code limits (defined in link.ld) */
+extern uint32_t kernel_start;
+extern uint32_t kernel_text_end;
+
+#define KERNEL_TEXT(addr)		((addr) >= (uint32_t) &kernel_start && (addr) < (uint32_t) &kernel_text_end)
 
 /*
- * Flush a Translation Lookaside Buffer entry.
+ * Add a free block to buddy allocator.
  */
-static inline void flush_tlb(uint32_t address)
+static inline void buddy_add(struct page *page, uint32_t order)
 {
-	__asm__ __volatile__("invlpg (%0)" :: "r" (address) : "memory");
+	page->buddy = 1;
+	page->order = order;
+	list_add(&page->list, &free_area[order].free_list);
+	free_area[order].nr_free++;
+	nr_free += 1 << order;
 }
 
 /*
- * Get a free page.
+ * Remove a free block from buddy allocator.
  */
-struct page *__get_free_page()
+static inline void buddy_del(struct page *page, uint32_t order)
 {
+	page->buddy = 0;
+	list_del(&page->list);
+	free_area[order].nr_free--;
+	nr_free -= 1 << order;
+}
+
+/*
+ * Release a block of pages to buddy allocator (merge it with free buddies).
+ */
+static void __free_pages_ok(struct page *page, uint32_t order)
+{
+	uint32_t page_idx = page->page, buddy_idx;
+	struct page *buddy;
+
+	/* merge with buddies */
+	for (; order < MAX_ORDER - 1; order++) {
+		/* buddy must be a free block of the same order */
+		buddy_idx = page_idx ^ (1 << order);
+		if (buddy_idx >= nr_pages)
+			break;
+		buddy = &page_table[buddy_idx];
+		if (!buddy->buddy || buddy->order != order)
+			break;
+
+		/* merge */
+		buddy_del(buddy, order);
+		page_idx &= ~(1 << order);
+	}
+
+	/* add free block */
+	buddy_add(&page_table[page_idx], order);
+}
+
+/*
+ * Remove a block of pages from buddy allocator (split bigger blocks if needed).
+ */
+static struct page *__rmqueue(uint32_t order)
+{
+	uint32_t current_order;
 	struct page *page;
 
-	/* try to get a page */
-	if (list_empty(&free_pages)) {
+	/* find smallest free block */
+	for (current_order = order; current_order < MAX_ORDER; current_order++)
+		if (!list_empty(&free_area[current_order].free_list))
+			break;
+
+	/* no free block */
+	if (current_order >= MAX_ORDER)
+		return NULL;
+
+	/* remove block */
+	page = list_first_entry(&free_area[current_order].free_list, struct page, list);
+	buddy_del(page, current_order);
+
+	/* split block and give back second halves */
+	while (current_order > order) {
+		current_order--;
+		buddy_add(page + (1 << current_order), current_order);
+	}
+
+	return page;
+}
+
+/*
+ * Give pre-zeroed pages back to buddy allocator (returns number of released pages).
+ */
+static uint32_t drain_zero_pages()
+{
+	uint32_t nr = 0, flags;
+	struct page *page;
+
+	irq_save(flags);
+
+	while (!list_empty(&zero_pages)) {
+		page = list_first_entry(&zero_pages, struct page, list);
+		list_del(&page->list);
+		nr_zero_pages--;
+
+		page->count = 0;
+		__free_pages_ok(page, 0);
+		nr++;
+	}
+
+	irq_restore(flags);
+
+	return nr;
+}
+
+/*
+ * Allocate 2^order contiguous pages.
+ */
+struct page *alloc_pages(uint32_t order)
+{
+	struct page *page;
+	uint32_t i;
+
+	/* check order */
+	if (order >= MAX_ORDER)
+		return NULL;
+
+	/* free memory is very low : reclaim pages synchronously */
+	if (nr_free < freepages.min)
+		reclaim_pages();
+
+	/* try to get pages */
+	page = __rmqueue(order);
+	if (!page) {
+		/* no more pages : give pre-zeroed pages back first */
+		if (drain_zero_pages())
+			page = __rmqueue(order);
+	}
+	if (!page) {
 		/* no more pages */
 		reclaim_pages();
 
-		if (list_empty(&free_pages))
+		page = __rmqueue(order);
+		if (!page)
 			return NULL;
 	}
 
-	/* get first free page */
-	page = list_first_entry(&free_pages, struct page, list);
-	page->inode = NULL;
-	page->offset = 0;
-	page->buffers = NULL;
-	page->count = 1;
+	/* init pages */
+	for (i = 0; i < (1U << order); i++) {
+		page[i].inode = NULL;
+		page[i].offset = 0;
+		page[i].buffers = NULL;
+		page[i].anon = 0;
+		page[i].count = 1;
+		INIT_LIST_HEAD(&page[i].list);
+	}
 
 	/* update lists */
-	list_del(&page->list);
 	list_add(&page->list, &used_pages);
 
+	/* free memory is low : wake up page reclaim daemon */
+	if (nr_free < freepages.low)
+		wakeup_kswapd();
+
 	return page;
 }
 
 /*
- * Free a page.
+ * Free 2^order contiguous pages.
  */
-void __free_page(struct page *page)
+void free_pages(struct page *page, uint32_t order)
 {
+	uint32_t i;
+
 	if (!page)
 		return;
 
+	/* still used */
 	page->count--;
-	if (!page->count) {
-		page->inode = NULL;
+	if (page->count)
+		return;
+
+	/* release pages */
+	for (i = 0; i < (1U << order); i++) {
+		page[i].inode = NULL;
+		page[i].count = 0;
+	}
+
+	/* anonymous page released */
+	if (page->anon) {
+		page->anon = 0;
+		nr_anon_pages--;
+	}
+
+	/* give pages back to buddy allocator */
+	lru_cache_del(page);
+	list_del(&page->list);
+	__free_pages_ok(page, order);
+}
+
+/*
+ * Get 2^order contiguous free pages.
+ */
+void *get_free_pages(uint32_t order)
+{
+	struct page *page;
+
+	/* get free pages */
+	page = alloc_pages(order);
+	if (!page)
+		return NULL;
+
+	/* make virtual address */
+	return (void *) PAGE_ADDRESS(page);
+}
+
+/*
+ * Get a free page.
+ */
+struct page *__get_free_page()
+{
+	return alloc_pages(0);
+}
+
+/*
+ * Get a zeroed page (pre-zeroed by idle task if possible).
+ */
+struct page *__get_zeroed_page()
+{
+	struct page *page = NULL;
+	uint32_t flags;
+
+	/* take a page from pre-zeroed pages pool */
+	irq_save(flags);
+	if (!list_empty(&zero_pages)) {
+		page = list_first_entry(&zero_pages, struct page, list);
 		list_del(&page->list);
-		list_add(&page->list, &free_pages);
+		list_add(&page->list, &used_pages);
+		nr_zero_pages--;
+		kstat.pgalloc_prezeroed++;
 	}
+	irq_restore(flags);
+
+	if (page)
+		return page;
+
+	/* else zero a free page */
+	page = __get_free_page();
+	if (!page)
+		return NULL;
+
+	clear_page((void *) PAGE_ADDRESS(page));
+
+	return page;
+}
+
+/*
+ * Zero a batch of free pages and put them in pre-zeroed pages pool (called by idle task).
+ */
+int refill_zero_pages()
+{
+	struct page *page;
+	uint32_t flags;
+	int nr;
+
+	for (nr = 0; nr < ZERO_PAGES_BATCH; nr++) {
+		/* pool is full or free memory is needed (don't wake up page reclaim) */
+		if (nr_zero_pages >= zero_pages_high || nr_free <= freepages.high)
+			break;
+
+		/* get a free page */
+		irq_save(flags);
+		page = __get_free_page();
+		if (page)
+			list_del(&page->list);
+		irq_restore(flags);
+		if (!page)
+			break;
+
+		/* zero it */
+		clear_page((void *) PAGE_ADDRESS(page));
+		kstat.pgzero_idle++;
+
+		/* add it to pool */
+		irq_save(flags);
+		list_add(&page->list, &zero_pages);
+		nr_zero_pages++;
+		irq_restore(flags);
+	}
+
+	return nr;
+}
+
+/*
+ * Free a page.
+ */
+void __free_page(struct page *page)
+{
+	free_pages(page, 0);
 }
 
 /*
@@ -106,39 +373,126 @@ void free_page(void *address)
 }
 
 /*
- * Reclaim pages, when memory is low.
+ * Get buddy allocator informations.
+ */
+int get_buddyinfo(char *buf, int count)
+{
+	uint32_t order;
+	int len;
+
+	/* print free blocks per order */
+	len = sprintf(buf, "Node 0, zone   Normal ");
+	for (order = 0; order < MAX_ORDER && len < count - 16; order++)
+		len += sprintf(buf + len, " %u", free_area[order].nr_free);
+	len += sprintf(buf + len, "\n");
+
+	return len;
+}
+
+/*
+ * Get number of free pages.
+ */
+uint32_t nr_free_pages()
+{
+	return nr_free + nr_zero_pages;
+}
+
+/*
+ * Account a page as anonymous user memory.
+ */
+static inline void page_add_anon(struct page *page)
+{
+	if (page->anon)
+		return;
+
+	page->anon = 1;
+	nr_anon_pages++;
+}
+
+/*
+ * Get pages usage by category (in kB).
  */
-void reclaim_pages()
+void get_page_usage(struct page_usage *usage)
 {
+	struct list_head *pos;
+	uint32_t i, flags;
+	struct task *task;
 	struct page *page;
-	uint32_t i;
 
+	memset(usage, 0, sizeof(struct page_usage));
+
+	/* classify used pages */
 	for (i = 0; i < nr_pages; i++) {
 		page = &page_table[i];
-
-		/* skip used pages */
-		if (page->count > 1)
+		if (page->count <= 0)
 			continue;
 
-		/* skip shared memory pages */
-		if (page->inode && page->inode->i_shm == 1)
-			continue;
+		if (page->slab)
+			usage->slab += PAGE_SIZE / 1024;
+		else if (is_swap_cache_page(page))
+			usage->swap_cached += PAGE_SIZE / 1024;
+		else if (page->inode)
+			usage->cached += PAGE_SIZE / 1024;
+		else if (page->buffers)
+			usage->buffers += PAGE_SIZE / 1024;
+	}
 
-		/* is it a buffer cached page ? */
-		if (page->buffers) {
-			try_to_free_buffer(page->buffers);
-			continue;
-		}
+	/* page tables */
+	usage->page_tables = nr_page_tables * PAGE_SIZE / 1024;
 
-		/* is it a page cached page ? */
-		if (page->inode) {
-			/* remove from page cache */
-			htable_delete(&page->htable);
+	/* anonymous memory (counted when pages are mapped, shared pages once) */
+	usage->anon = nr_anon_pages * PAGE_SIZE / 1024;
 
-			/* free page */
-			__free_page(page);
-		}
+	/* kernel stacks */
+	irq_save(flags);
+	list_for_each(pos, &tasks_list) {
+		task = list_entry(pos, struct task, list);
+		if (task->kernel_stack)
+			usage->kernel_stacks += STACK_SIZE / 1024;
+	}
+	irq_restore(flags);
+}
+
+/*
+ * Allocate a zeroed page table.
+ */
+static struct page_table *alloc_page_table(uint32_t *physical)
+{
+	struct page_table *pgt;
+	struct page *page;
+
+	/* direct map is not usable before paging is enabled : use identity mapped kernel heap */
+	if (!current_pgd) {
+		pgt = (struct page_table *) kmalloc_align(sizeof(struct page_table));
+		if (!pgt)
+			return NULL;
+
+		clear_page(pgt);
+		*physical = (uint32_t) pgt;
+		return pgt;
 	}
+
+	/* else use a pre-zeroed page */
+	page = __get_zeroed_page();
+	if (!page)
+		return NULL;
+
+	nr_page_tables++;
+
+	*physical = page->page << PAGE_SHIFT;
+	return (struct page_table *) PAGE_ADDRESS(page);
+}
+
+/*
+ * Release a page table memory.
+ */
+void release_page_table(struct page_table *pgt)
+{
+	if ((uint32_t) pgt >= KPAGE_START) {
+		free_page(pgt);
+		nr_page_tables--;
+	} else
+		kfree(pgt);
 }
 
 /*
@@ -146,25 +500,28 @@ void reclaim_pages()
  */
 static uint32_t *get_pte(uint32_t address, uint8_t make, struct page_directory *pgd)
 {
-	uint32_t page_nr, table_idx;
+	uint32_t page_nr, table_idx, physical;
 
 	/* get page table */
 	page_nr = address / PAGE_SIZE;
 	table_idx = page_nr / 1024;
 
+	/* 4 MB page : no page table */
+	if (pgd->tables_physical[table_idx] & PAGE_PSE)
+		return NULL;
+
 	/* table already assigned */
 	if (pgd->tables[table_idx])
 		return &pgd->tables[table_idx]->pages[page_nr % 1024];
 
 	/* create a new page table */
 	if (make) {
-		pgd->tables[table_idx] = (struct page_table *) kmalloc_align(sizeof(struct page_table));
+		pgd->tables[table_idx] = alloc_page_table(&physical);
 		if (!pgd->tables[table_idx])
 			return NULL;
 
 		/* set page table entry */
-		memset(pgd->tables[table_idx], 0, PAGE_SIZE);
-		pgd->tables_physical[table_idx] = (uint32_t) pgd->tables[table_idx] | 0x7;
+		pgd->tables_physical[table_idx] = physical | 0x7;
 
 		/* flush tlb */
 		flush_tlb(address);
@@ -269,6 +626,13 @@ static void unmap_page(uint32_t address, struct page_directory *pgd)
 	if (!pte)
 		return;
 
+	/* swapped page : release swap entry */
+	if (PTE_SWAP(*pte)) {
+		swap_free(*pte);
+		*pte = 0;
+		return;
+	}
+
 	/* free page */
 	page_idx = PTE_PAGE(*pte);
 	if (page_idx && page_idx < nr_pages)
@@ -286,34 +650,90 @@ static void unmap_page(uint32_t address, struct page_directory *pgd)
  */
 void unmap_pages(uint32_t start_address, uint32_t end_address, struct page_directory *pgd)
 {
-	uint32_t address;
+	uint32_t address, next, idx;
 
 	/* unmap all pages */
-	for (address = start_address; address < end_address; address += PAGE_SIZE)
+	for (address = start_address; address < end_address; address = next) {
+		idx = address >> HPAGE_SHIFT;
+		next = address + PAGE_SIZE;
+
+		/* user 4 MB page : free it as a whole */
+		if ((pgd->tables_physical[idx] & PAGE_PSE) && pgd->tables_physical[idx] != kernel_pgd->tables_physical[idx]) {
+			free_huge_page(pgd->tables_physical[idx]);
+			pgd->tables_physical[idx] = 0;
+			flush_tlb(address);
+
+			/* go to next page directory entry */
+			next = (address & HPAGE_MASK) + HPAGE_SIZE;
+			if (!next)
+				break;
+			continue;
+		}
+
 		unmap_page(address, pgd);
+	}
+}
+
+/*
+ * Move page table entries (pages and swap entries keep their reference counts).
+ */
+int move_page_tables(struct page_directory *pgd, uint32_t old_address, uint32_t new_address, size_t size)
+{
+	uint32_t offset, *src, *dst;
+
+	/* allocate destination page tables first (moving can't fail then) */
+	for (offset = 0; offset < size; offset += PAGE_SIZE) {
+		src = get_pte(old_address + offset, 0, pgd);
+		if (src && *src && !get_pte(new_address + offset, 1, pgd))
+			return -ENOMEM;
+	}
+
+	/* move page table entries */
+	for (offset = 0; offset < size; offset += PAGE_SIZE) {
+		src = get_pte(old_address + offset, 0, pgd);
+		if (!src || !*src)
+			continue;
+
+		dst = get_pte(new_address + offset, 0, pgd);
+		*dst = *src;
+		*src = 0;
+		flush_tlb(old_address + offset);
+	}
+
+	return 0;
 }
 
 /*
  * Anonymous page mapping.
  */
-static int do_anonymous_page(struct vm_area *vma, uint32_t *pte)
+static int do_anonymous_page(struct vm_area *vma, uint32_t *pte, int write_access)
 {
 	struct page *page;
-	int ret;
+	int ret, prot;
 
-	/* try to get a page */
-	page = __get_free_page();
+	/* read access to private memory : map shared zero page read only (a page will be allocated on first write) */
+	if (!write_access && !(vma->vm_flags & VM_SHARED)) {
+		zero_page->count++;
+		*pte = MK_PTE(zero_page->page, vma->vm_page_prot & ~PAGE_RW);
+		return 0;
+	}
+
+	/* try to get a zeroed page */
+	page = __get_zeroed_page();
 	if (!page)
 		return -ENOMEM;
 
-	/* memzero page */
-	memset((void *) PAGE_ADDRESS(page), 0, PAGE_SIZE);
+	/* write access : map page writable now (avoid a write protect fault) */
+	prot = vma->vm_page_prot;
+	if (write_access)
+		prot |= PAGE_RW | PAGE_DIRTY;
 
 	/* set page table entry */
-	ret = set_pte(pte, vma->vm_page_prot, page);
+	ret = set_pte(pte, prot, page);
 	if (ret)
 		goto err;
 
+	page_add_anon(page);
 	return 0;
 err:
 	__free_page(page);
@@ -321,44 +741,66 @@ err:
 }
 
 /*
- * Handle a no page fault.
+ * Swap a page in.
  */
-static int do_no_page(struct task *task, struct vm_area *vma, uint32_t address)
+int do_swap_page(struct vm_area *vma, uint32_t address, uint32_t *pte)
 {
-	struct page *page;
-	uint32_t *pte;
+	uint32_t entry = *pte, flags;
+	struct page *page, *cached;
+	int ret;
 
-	/* get page table entry */
-	pte = get_pte(address, 1, task->mm->pgd);
-	if (!pte)
-		return -ENOMEM;
+	/* try to get page from swap cache */
+	page = lookup_swap_cache(entry);
+	if (!page) {
+		/* get a new page */
+		page = __get_free_page();
+		if (!page)
+			return -ENOMEM;
 
-	/* page table entry already set */
-	if (PTE_PAGE(*pte) != 0)
-		return -EPERM;
+		/* read it from swap */
+		ret = rw_swap_page(SWAP_READ, entry, page);
+		if (ret) {
+			__free_page(page);
+			return ret;
+		}
 
-	/* anonymous page mapping */
-	if (!vma->vm_ops || !vma->vm_ops->nopage)
-		return do_anonymous_page(vma, pte);
+		/* page may have been read meanwhile : use cached one */
+		irq_save(flags);
+		cached = lookup_swap_cache(entry);
+		if (cached) {
+			__free_page(page);
+			page = cached;
+		} else if (*pte == entry) {
+			add_to_swap_cache(page, entry);
+		}
+		irq_restore(flags);
+	}
 
-	/* specific mapping */
-	page = vma->vm_ops->nopage(vma, address);
-	if (!page)
-		return -ENOSPC;
+	/* page table entry changed meanwhile (page already swapped in) */
+	irq_save(flags);
+	if (*pte != entry) {
+		irq_restore(flags);
+		__free_page(page);
+		return 0;
+	}
 
-	/* set page table entry */
-	set_pte(pte, vma->vm_page_prot, page);
+	/* map page (swap cache copy is dropped with last swap reference) */
+	*pte = MK_PTE(page->page, vma->vm_page_prot);
+	flush_tlb(address);
+	page_add_anon(page);
+	swap_free(entry);
+	irq_restore(flags);
 
 	return 0;
 }
 
 /*
- * Handle a read only page fault.
+ * Handle a read only page fault (copy on write).
  */
-static int do_wp_page(struct task *task, uint32_t address)
+static int do_wp_page(struct task *task, struct vm_area *vma, uint32_t address)
 {
+	struct page *page, *new_page;
 	uint32_t *pte, page_idx;
-	struct page *page;
 
 	/* get page table entry */
 	pte = get_pte(address, 0, task->mm->pgd);
@@ -371,8 +813,154 @@ static int do_wp_page(struct task *task, uint32_t address)
 		return -EINVAL;
 	page = &page_table[page_idx];
 
-	/* make page table entry writable */
-	*pte = MK_PTE(page->page, PTE_PROT(*pte) | PAGE_RW | PAGE_DIRTY);
+	/* shared zero page : map a new zeroed page (nothing to copy) */
+	if (page == zero_page) {
+		new_page = __get_zeroed_page();
+		if (!new_page)
+			return -ENOMEM;
+
+		*pte = MK_PTE(new_page->page, PTE_PROT(*pte) | PAGE_RW | PAGE_DIRTY);
+		flush_tlb(address);
+		page_add_anon(new_page);
+		__free_page(page);
+		return 0;
+	}
+
+	/* shared mapping or page used only by this task (file pages are never written through private mappings) : make page table entry writable */
+	if ((vma->vm_flags & VM_SHARED) || (page->count == 1 && !page->inode)) {
+		*pte = MK_PTE(page->page, PTE_PROT(*pte) | PAGE_RW | PAGE_DIRTY);
+		flush_tlb(address);
+
+		/* private page not shared anymore : copy avoided */
+		if (!(vma->vm_flags & VM_SHARED))
+			kstat.cow_saved++;
+
+		return 0;
+	}
+
+	/* page is shared : get a new page */
+	new_page = __get_free_page();
+	if (!new_page)
+		return -ENOMEM;
+
+	/* copy page */
+	copy_page((void *) PAGE_ADDRESS(new_page), (void *) PAGE_ADDRESS(page));
+
+	/* set page table entry */
+	*pte = MK_PTE(new_page->page, PTE_PROT(*pte) | PAGE_RW | PAGE_DIRTY);
+	flush_tlb(address);
+	page_add_anon(new_page);
+
+	/* release shared page */
+	__free_page(page);
+
+	/* update statistics */
+	kstat.cow_faults++;
+
+	return 0;
+}
+
+/*
+ * Map cached file pages around a faulting address (they are likely to be accessed soon).
+ */
+static void do_fault_around(struct vm_area *vma, uint32_t address, uint32_t *pte)
+{
+	struct inode *inode = vma->vm_inode;
+	uint32_t start, end, addr, offset, *ptes;
+	struct page *page;
+
+	/* fault around disabled (or random access expected) */
+	if (fault_around_pages <= 1 || !inode || (vma->vm_flags & VM_RAND_READ))
+		return;
+
+	/* window is aligned on its size, so it never crosses a page table */
+	address = PAGE_ALIGN_DOWN(address);
+	start = address & ~(fault_around_pages * PAGE_SIZE - 1);
+	end = start + fault_around_pages * PAGE_SIZE;
+
+	/* sequential access expected : read window ahead of faulting address into page cache */
+	if (vma->vm_flags & VM_SEQ_READ) {
+		start = address;
+		end = start + fault_around_pages * PAGE_SIZE;
+		if ((end & HPAGE_MASK) != (start & HPAGE_MASK))
+			end = (start & HPAGE_MASK) + HPAGE_SIZE;
+		if (end > vma->vm_end || end < start)
+			end = vma->vm_end;
+
+		page_cache_readahead(inode, address - vma->vm_start + vma->vm_offset + PAGE_SIZE, end - address - PAGE_SIZE);
+	}
+
+	if (start < vma->vm_start)
+		start = vma->vm_start;
+	if (end > vma->vm_end || end < start)
+		end = vma->vm_end;
+
+	/* first page table entry of the window */
+	ptes = pte - ((address - start) >> PAGE_SHIFT);
+
+	for (addr = start; addr < end; addr += PAGE_SIZE, ptes++) {
+		/* faulting page or page table entry already set (or swapped) */
+		if (addr == address || *ptes)
+			continue;
+
+		/* end of file */
+		offset = addr - vma->vm_start + vma->vm_offset;
+		if (offset >= inode->i_size)
+			break;
+
+		/* only map pages already cached (and not being read) */
+		page = find_page(inode, offset);
+		if (!page)
+			continue;
+		if (page->locked) {
+			__free_page(page);
+			continue;
+		}
+
+		*ptes = MK_PTE(page->page, vma->vm_page_prot);
+		kstat.pgfault_around++;
+	}
+}
+
+/*
+ * Handle a no page fault.
+ */
+static int do_no_page(struct task *task, struct vm_area *vma, uint32_t address, int write_access)
+{
+	struct page *page;
+	uint32_t *pte;
+
+	/* get page table entry */
+	pte = get_pte(address, 1, task->mm->pgd);
+	if (!pte)
+		return -ENOMEM;
+
+	/* swapped page */
+	if (PTE_SWAP(*pte))
+		return do_swap_page(vma, address, pte);
+
+	/* page table entry already set */
+	if (PTE_PAGE(*pte) != 0)
+		return -EPERM;
+
+	/* anonymous page mapping */
+	if (!vma->vm_ops || !vma->vm_ops->nopage)
+		return do_anonymous_page(vma, pte, write_access);
+
+	/* specific mapping */
+	page = vma->vm_ops->nopage(vma, address);
+	if (!page)
+		return -ENOSPC;
+
+	/* set page table entry */
+	set_pte(pte, vma->vm_page_prot, page);
+
+	/* map neighbour cached pages */
+	do_fault_around(vma, address, pte);
+
+	/* private mapping of a cached page : break sharing now rather than on next fault */
+	if (write_access && !(vma->vm_flags & VM_SHARED))
+		return do_wp_page(task, vma, address);
 
 	return 0;
 }
@@ -395,6 +983,9 @@ void page_fault_handler(struct registers *regs)
 		return;
 	}
 
+	/* update statistics */
+	kstat.pgfault++;
+
 	/* get errors informations */
 	int present = regs->err_code & 0x1 ? 1 : 0;
 	int write = regs->err_code & 0x2 ? 1 : 0;
@@ -416,23 +1007,34 @@ void page_fault_handler(struct registers *regs)
 	goto bad_area;
 expand_stack:
 	vma->vm_start = fault_addr & PAGE_MASK;
+	vma_gap_update(vma);
 	return;
 good_area:
 	/* write violation */
 	if (write && !(vma->vm_flags & VM_WRITE))
 		goto bad_area;
 
+	/* huge page mapping */
+	if (vma->vm_flags & VM_HUGETLB) {
+		ret = do_huge_page(current_task->mm->pgd, vma, fault_addr);
+		goto out;
+	}
+
 	/* present page : try to make it writable */
 	if (present) {
-		ret = do_wp_page(current_task, fault_addr);
-		if (ret)
+		if (!write)
 			goto bad_area;
-		else
-			return;
+
+		ret = do_wp_page(current_task, vma, fault_addr);
+		goto out;
 	}
 
 	/* non present page */
-	ret = do_no_page(current_task, vma, fault_addr);
+	ret = do_no_page(current_task, vma, fault_addr, write);
+out:
+	/* out of memory : swap pages out and retry */
+	if (ret == -ENOMEM && swap_out(SWAP_CLUSTER))
+		goto good_area;
 	if (ret)
 		goto bad_area;
 
@@ -442,8 +1044,8 @@ bad_area:
 	printf("Page fault at address=%x | present=%d write-access=%d user-mode=%d reserved=%d instruction-fetch=%d (process %d at %x)\n",
 	       fault_addr, present, write, user, reserved, id, current_task->pid, regs->eip);
 
-	/* user mode : exit process */
-	if (user)
+	/* user mode or kernel access to a user memory region (write protection) : exit process */
+	if (user || find_vma(current_task, fault_addr))
 		sys_exit(1);
 
 	/* otherwise panic */
@@ -458,54 +1060,56 @@ void switch_page_directory(struct page_directory *pgd)
 	uint32_t cr0;
 
 	/* switch */
+	current_pgd = pgd;
 	__asm__ volatile("mov %0, %%cr3" :: "r" (pgd->tables_physical));
 	__asm__ volatile("mov %%cr0, %0" : "=r" (cr0));
 
-	/* enable paging */
-	cr0 |= 0x80000000;
+	/* enable paging and write protection (kernel writes to read only user pages must fault, for copy on write) */
+	cr0 |= 0x80010000;
 	__asm__ volatile("mov %0, %%cr0" :: "r" (cr0));
 }
 
 
 /*
- * Clone a page table.
+ * Clone a page table (pages are shared and write protected : they will be copied on write).
  */
-static struct page_table *clone_page_table(struct page_table *src)
+static struct page_table *clone_page_table(struct page_table *src, uint32_t *physical)
 {
 	struct page_table *pgt;
-	struct page *page;
-	int ret, i;
+	uint32_t page_idx;
+	int i;
 
 	/* create a new page table */
-	pgt = (struct page_table *) kmalloc_align(sizeof(struct page_table));
+	pgt = alloc_page_table(physical);
 	if (!pgt)
 		return NULL;
 
-	/* reset page table */
-	memset(pgt, 0, sizeof(struct page_table));
-
-	/* copy physical pages */
+	/* share physical pages */
 	for (i = 0; i < 1024; i++) {
-		if (!PTE_PAGE(src->pages[i]))
+		/* swapped page : share swap entry */
+		if (PTE_SWAP(src->pages[i])) {
+			swap_duplicate(src->pages[i]);
+			pgt->pages[i] = src->pages[i];
 			continue;
-
-		/* try to get a page */
-		page = __get_free_page();
-		if (!page) {
-			kfree(pgt);
-			return NULL;
 		}
 
-		/* set page table entry */
-		ret = set_pte(&pgt->pages[i], PTE_PROT(src->pages[i]), page);
-		if (ret) {
-			__free_page(page);
-			kfree(pgt);
-			return NULL;
+		page_idx = PTE_PAGE(src->pages[i]);
+		if (!page_idx)
+			continue;
+
+		/* not a memory page (device mapping) : just copy page table entry */
+		if (page_idx >= nr_pages) {
+			pgt->pages[i] = src->pages[i];
+			continue;
 		}
 
-		/* copy physical page */
-		copy_page_physical(PTE_PAGE(src->pages[i]) * PAGE_SIZE, PTE_PAGE(pgt->pages[i]) * PAGE_SIZE);
+		/* write protect page in both tables */
+		src->pages[i] &= ~PAGE_RW;
+		pgt->pages[i] = src->pages[i];
+
+		/* update page reference count */
+		page_table[page_idx].count++;
+		kstat.cow_shared++;
 	}
 
 	return pgt;
@@ -517,6 +1121,7 @@ static struct page_table *clone_page_table(struct page_table *src)
 struct page_directory *clone_page_directory(struct page_directory *src)
 {
 	struct page_directory *ret;
+	uint32_t physical;
 	int i;
 
 	/* create a new page directory */
@@ -529,6 +1134,21 @@ struct page_directory *clone_page_directory(struct page_directory *src)
 
 	/* copy page tables */
 	for (i = 0; i < 1024; i++) {
+		/* 4 MB page : link kernel pages, copy user pages */
+		if (src->tables_physical[i] & PAGE_PSE) {
+			if (src->tables_physical[i] == kernel_pgd->tables_physical[i])
+				ret->tables_physical[i] = src->tables_physical[i];
+			else
+				ret->tables_physical[i] = clone_huge_page(src->tables_physical[i]);
+
+			if (!ret->tables_physical[i]) {
+				free_page_directory(ret);
+				return NULL;
+			}
+
+			continue;
+		}
+
 		if (!src->tables[i])
 			continue;
 
@@ -537,16 +1157,19 @@ struct page_directory *clone_page_directory(struct page_directory *src)
 			ret->tables[i] = src->tables[i];
 			ret->tables_physical[i] = src->tables_physical[i];
 		} else {
-			ret->tables[i] = clone_page_table(src->tables[i]);
+			ret->tables[i] = clone_page_table(src->tables[i], &physical);
 			if (!ret->tables[i]) {
 				free_page_directory(ret);
 				return NULL;
 			}
 
-			ret->tables_physical[i] = (uint32_t) ret->tables[i] | 0x07;
+			ret->tables_physical[i] = physical | 0x07;
 		}
 	}
 
+	/* source pages have been write protected */
+	flush_tlb_all();
+
 	return ret;
 }
 
@@ -555,20 +1178,22 @@ struct page_directory *clone_page_directory(struct page_directory *src)
  */
 static void free_page_table(struct page_table *pgt)
 {
-	struct page *page;
 	uint32_t page_idx;
 	int i;
 
 	for (i = 0; i < 1024; i++) {
-		page_idx = PTE_PAGE(pgt->pages[i]);
-		if (page_idx > 0 && page_idx < nr_pages) {
-			page = &page_table[page_idx];
-			list_del(&page->list);
-			list_add(&page->list, &free_pages);
+		/* swapped page */
+		if (PTE_SWAP(pgt->pages[i])) {
+			swap_free(pgt->pages[i]);
+			continue;
 		}
+
+		page_idx = PTE_PAGE(pgt->pages[i]);
+		if (page_idx > 0 && page_idx < nr_pages)
+			__free_page(&page_table[page_idx]);
 	}
 
-	kfree(pgt);
+	release_page_table(pgt);
 }
 
 /*
@@ -581,10 +1206,17 @@ void free_page_directory(struct page_directory *pgd)
 	if (!pgd)
 		return;
 
-	/* free page tables */
-	for (i = 0; i < 1024; i++)
-		if (pgd->tables[i] && pgd->tables[i] != kernel_pgd->tables[i])
+	/* page directory may still be loaded (by a kernel thread) : never keep a freed one in CR3 */
+	if (pgd == current_pgd)
+		switch_page_directory(kernel_pgd);
+
+	/* free page tables and user 4 MB pages */
+	for (i = 0; i < 1024; i++) {
+		if ((pgd->tables_physical[i] & PAGE_PSE) && pgd->tables_physical[i] != kernel_pgd->tables_physical[i])
+			free_huge_page(pgd->tables_physical[i]);
+		else if (pgd->tables[i] && pgd->tables[i] != kernel_pgd->tables[i])
 			free_page_table(pgd->tables[i]);
+	}
 
 	/* free page directory */
 	kfree(pgd);
@@ -607,7 +1239,7 @@ static inline uint32_t __page_hashfn(struct inode *inode, off_t offset)
 /*
  * Find a page in hash table.
  */
-struct page *find_page(struct inode *inode, off_t offset)
+struct page *__find_page(struct inode *inode, off_t offset)
 {
 	struct htable_link *node;
 	struct page *page;
@@ -616,10 +1248,8 @@ struct page *find_page(struct inode *inode, off_t offset)
 	node = htable_lookup(page_htable, __page_hashfn(inode, offset), page_htable_bits);
 	while (node) {
 		page = htable_entry(node, struct page, htable);
-		if (page->inode == inode && page->offset == offset) {
-			page->count++;
+		if (page->inode == inode && page->offset == offset)
 			return page;
-		}
 
 		node = node->next;
 	}
@@ -627,6 +1257,22 @@ struct page *find_page(struct inode *inode, off_t offset)
 	return NULL;
 }
 
+/*
+ * Find and get a cached page.
+ */
+struct page *find_page(struct inode *inode, off_t offset)
+{
+	struct page *page;
+
+	page = __find_page(inode, offset);
+	if (page) {
+		mark_page_accessed(page);
+		page->count++;
+	}
+
+	return page;
+}
+
 /*
  * Cache a page.
  */
@@ -644,6 +1290,9 @@ void add_to_page_cache(struct page *page, struct inode *inode, off_t offset)
 	/* add page to inode */
 	list_del(&page->list);
 	list_add(&page->list, &inode->i_pages);
+
+	/* add page to LRU lists */
+	lru_cache_add(page);
 }
 
 /*
@@ -651,26 +1300,17 @@ void add_to_page_cache(struct page *page, struct inode *inode, off_t offset)
  */
 int init_page_cache()
 {
-	uint32_t addr, nr, i;
+	size_t size;
 
 	/* compute htable bits */
 	page_htable_bits = blksize_bits(nr_pages);
 
-	/* allocate page hash table */
-	nr = 1 + nr_pages * sizeof(struct htable_link *) / PAGE_SIZE;
-	for (i = 0; i < nr; i++) {
-		/* get a free page */
-		addr = (uint32_t) get_free_page();
-		if (!addr)
-			return -ENOMEM;
-
-		/* reset page */
-		memset((void *) addr, 0, PAGE_SIZE);
-
-		/* set buffer hash table */
-		if (i == 0)
-			page_htable = (struct htable_link **) addr;
-	}
+	/* allocate page hash table (one contiguous block) */
+	size = (1 << page_htable_bits) * sizeof(struct htable_link *);
+	page_htable = (struct htable_link **) get_free_pages(get_order(size));
+	if (!page_htable)
+		return -ENOMEM;
+	memset(page_htable, 0, size);
 
 	return 0;
 }
@@ -680,7 +1320,7 @@ int init_page_cache()
  */
 int init_paging(uint32_t start, uint32_t end)
 {
-	uint32_t addr, last_kernel_addr, i, *pte;
+	uint32_t addr, last_kernel_addr, order, i, *pte, global = 0;
 	int ret;
 
 	/* unused start address */
@@ -699,43 +1339,98 @@ int init_paging(uint32_t start, uint32_t end)
 	memset(page_table, 0, sizeof(struct page) * nr_pages);
 	last_kernel_addr += sizeof(struct page) * nr_pages;
 
+	/* init buddy allocator */
+	for (order = 0; order < MAX_ORDER; order++) {
+		INIT_LIST_HEAD(&free_area[order].free_list);
+		free_area[order].nr_free = 0;
+	}
+
+	/* pre-zeroed pages pool size */
+	zero_pages_high = nr_pages / 64;
+	if (zero_pages_high > ZERO_PAGES_MAX)
+		zero_pages_high = ZERO_PAGES_MAX;
+
 	/* init pages */
-	INIT_LIST_HEAD(&free_pages);
 	INIT_LIST_HEAD(&used_pages);
 	for (i = 0; i < nr_pages; i++) {
 		page_table[i].page = i;
+		INIT_LIST_HEAD(&page_table[i].list);
 
-		/* add pages to used/free list */
+		/* add kernel pages to used list */
 		if (i * PAGE_SIZE < last_kernel_addr) {
 			page_table[i].count = 1;
 			list_add_tail(&page_table[i].list, &used_pages);
-		} else {
-			list_add_tail(&page_table[i].list, &free_pages);
 		}
 	}
 
+	/* give free pages to buddy allocator (biggest aligned blocks) */
+	for (i = PAGE_ALIGN_UP(last_kernel_addr) / PAGE_SIZE; i < nr_pages; i += 1 << order) {
+		for (order = MAX_ORDER - 1; order > 0; order--)
+			if (!(i & ((1 << order) - 1)) && i + (1 << order) <= nr_pages)
+				break;
+
+		buddy_add(&page_table[i], order);
+	}
+
+	/* use 4 MB pages for kernel mappings if supported */
+	if (cpu_has_feature(X86_FEATURE_PSE)) {
+		write_cr4(read_cr4() | X86_CR4_PSE);
+		pse_enabled = 1;
+	}
+
+	/* use non temporal SSE2 stores to copy/clear pages if supported (user tasks get SSE too : registers are switched lazily per task) */
+	if (cpu_has_feature(X86_FEATURE_SSE2) && cpu_has_feature(X86_FEATURE_FXSR)) {
+		write_cr0(read_cr0() & ~(X86_CR0_EM | X86_CR0_TS));
+		write_cr4(read_cr4() | X86_CR4_OSFXSR);
+		sse2_enabled = 1;
+		init_fpu();
+	}
+
+	/* kernel mappings are the same in all page directories : keep them in TLB on switch */
+	if (cpu_has_feature(X86_FEATURE_PGE)) {
+		write_cr4(read_cr4() | X86_CR4_PGE);
+		global = PAGE_GLOBAL;
+	}
+
 	/* identity map kernel pages */
 	for (i = 0, addr = 0; addr < last_kernel_addr; i++, addr += PAGE_SIZE) {
+		/* whole 4 MB of kernel data : map a 4 MB page */
+		if (pse_enabled && !(addr & ~HPAGE_MASK) && addr + HPAGE_SIZE <= last_kernel_addr
+		    && (addr >= (uint32_t) &kernel_text_end || addr + HPAGE_SIZE <= (uint32_t) &kernel_start)) {
+			kernel_pgd->tables_physical[addr >> HPAGE_SHIFT] = addr | PAGE_KERNEL | PAGE_PSE | global;
+			i += 1023;
+			addr += HPAGE_SIZE - PAGE_SIZE;
+			continue;
+		}
+
 		/* make page table entry */
 		pte = get_pte(addr, 1, kernel_pgd);
 		if (!pte)
 			return -ENOMEM;
 
-		/* set page table entry */
-		ret = set_pte(pte, PAGE_READONLY, &page_table[i]);
+		/* set page table entry (kernel code is readable from user mode for signal trampoline) */
+		ret = set_pte(pte, (KERNEL_TEXT(addr) ? PAGE_READONLY : PAGE_KERNEL) | global, &page_table[i]);
 		if (ret)
 			return ret;
 	}
 
 	/* map physical pages to highmem */
 	for (i = 0, addr = KPAGE_START; i < nr_pages; i++, addr += PAGE_SIZE) {
+		/* whole 4 MB of free memory : map a 4 MB page */
+		if (pse_enabled && !(addr & ~HPAGE_MASK) && i + 1024 <= nr_pages && V2P(addr) >= last_kernel_addr) {
+			kernel_pgd->tables_physical[addr >> HPAGE_SHIFT] = V2P(addr) | PAGE_KERNEL | PAGE_PSE | global;
+			i += 1023;
+			addr += HPAGE_SIZE - PAGE_SIZE;
+			continue;
+		}
+
 		/* make page table entry */
 		pte = get_pte(addr, 1, kernel_pgd);
 		if (!pte)
 			return -ENOMEM;
 
 		/* set page table entry */
-		ret = set_pte(pte, V2P(addr) < last_kernel_addr ? PAGE_READONLY : PAGE_KERNEL, &page_table[i]);
+		ret = set_pte(pte, (V2P(addr) < last_kernel_addr ? PAGE_READONLY : PAGE_KERNEL) | global, &page_table[i]);
 		if (ret)
 			return ret;
 	}
@@ -746,6 +1441,11 @@ int init_paging(uint32_t start, uint32_t end)
 	/* enable paging */
 	switch_page_directory(kernel_pgd);
 
+	/* allocate shared zero page (never freed : mappings hold extra references) */
+	zero_page = __get_zeroed_page();
+	if (!zero_page)
+		return -ENOMEM;
+
 	/* init page cache */
 	return init_page_cache();
 }
@@ -0,0 +1,384 @@
+#include <mm/slab.h>
+#include <mm/mm.h>
+#include <mm/paging.h>
+#include <string.h>
+#include <stderr.h>
+#include <stdio.h>
+
+#define SLAB_ALIGN			sizeof(uint32_t)
+#define SLAB_OFF_SLAB_LIMIT		(PAGE_SIZE >> 3)
+#define SLAB_DESC_SIZE(num)		(sizeof(struct slab) + (num) * sizeof(uint16_t))
+#define SLAB_END			0xFFFF
+#define NR_SIZE_CACHES			(sizeof(size_caches_sizes) / sizeof(size_caches_sizes[0]))
+
+/* caches list */
+static LIST_HEAD(cache_list);
+
+/* cache of caches */
+static struct kmem_cache cache_cache;
+
+/* kmalloc size caches */
+static size_t size_caches_sizes[] = { 32, 64, 128, 256, 512, 1024, 2048 };
+static char *size_caches_names[] = { "size-32", "size-64", "size-128", "size-256", "size-512", "size-1024", "size-2048" };
+static struct kmem_cache *size_caches[NR_SIZE_CACHES];
+static int size_caches_ready = 0;
+
+/*
+ * Init a cache.
+ */
+static void kmem_cache_setup(struct kmem_cache *cache, const char *name, size_t size, void (*ctor)(void *))
+{
+	/* set cache */
+	memset(cache, 0, sizeof(struct kmem_cache));
+	strncpy(cache->name, name, KMEM_CACHE_NAME_LEN - 1);
+	cache->size = ALIGN_UP(size, SLAB_ALIGN);
+	cache->ctor = ctor;
+	INIT_LIST_HEAD(&cache->slabs_full);
+	INIT_LIST_HEAD(&cache->slabs_partial);
+	INIT_LIST_HEAD(&cache->slabs_free);
+
+	/* compute number of objects per slab (big objects : keep slab descriptor outside of the page) */
+	if (cache->size >= SLAB_OFF_SLAB_LIMIT) {
+		cache->off_slab = 1;
+		cache->num = PAGE_SIZE / cache->size;
+	} else {
+		cache->off_slab = 0;
+		cache->num = PAGE_SIZE / cache->size;
+		while (cache->num && ALIGN_UP(SLAB_DESC_SIZE(cache->num), SLAB_ALIGN) + cache->num * cache->size > PAGE_SIZE)
+			cache->num--;
+	}
+
+	/* add cache */
+	list_add_tail(&cache->list, &cache_list);
+}
+
+/*
+ * Create a cache.
+ */
+struct kmem_cache *kmem_cache_create(const char *name, size_t size, void (*ctor)(void *))
+{
+	struct kmem_cache *cache;
+
+	/* check size */
+	if (!size || size > PAGE_SIZE)
+		return NULL;
+
+	/* allocate a new cache */
+	cache = kmem_cache_alloc(&cache_cache);
+	if (!cache)
+		return NULL;
+
+	/* init cache */
+	kmem_cache_setup(cache, name, size, ctor);
+
+	return cache;
+}
+
+/*
+ * Grow a cache (add a new empty slab).
+ */
+static int kmem_cache_grow(struct kmem_cache *cache)
+{
+	struct slab *slab;
+	uint32_t i;
+	void *page;
+
+	/* get a new page */
+	page = get_free_page();
+	if (!page)
+		return -ENOMEM;
+
+	/* allocate slab descriptor */
+	if (cache->off_slab) {
+		slab = kmalloc(SLAB_DESC_SIZE(cache->num));
+		if (!slab) {
+			free_page(page);
+			return -ENOMEM;
+		}
+
+		slab->s_mem = page;
+	} else {
+		slab = (struct slab *) page;
+		slab->s_mem = page + ALIGN_UP(SLAB_DESC_SIZE(cache->num), SLAB_ALIGN);
+	}
+
+	/* set slab */
+	slab->cache = cache;
+	slab->inuse = 0;
+	slab->free = 0;
+
+	/* chain free objects and construct them */
+	for (i = 0; i < cache->num; i++) {
+		slab->bufctl[i] = i + 1 < cache->num ? i + 1 : SLAB_END;
+
+		if (cache->ctor)
+			cache->ctor(slab->s_mem + i * cache->size);
+	}
+
+	/* link page to slab */
+	page_table[MAP_NR((uint32_t) page)].slab = slab;
+
+	/* add slab to cache */
+	list_add(&slab->list, &cache->slabs_free);
+	cache->nr_slabs++;
+
+	return 0;
+}
+
+/*
+ * Destroy a slab.
+ */
+static void kmem_slab_destroy(struct kmem_cache *cache, struct slab *slab)
+{
+	void *page = (void *) PAGE_ALIGN_DOWN((uint32_t) slab->s_mem);
+
+	/* unlink page */
+	page_table[MAP_NR((uint32_t) page)].slab = NULL;
+
+	/* remove slab from cache */
+	list_del(&slab->list);
+	cache->nr_slabs--;
+
+	/* free slab descriptor */
+	if (cache->off_slab)
+		kfree(slab);
+
+	/* free page */
+	free_page(page);
+}
+
+/*
+ * Allocate an object from a cache.
+ */
+void *kmem_cache_alloc(struct kmem_cache *cache)
+{
+	struct slab *slab;
+	void *obj;
+
+	/* no partial slab : use an empty one */
+	if (list_empty(&cache->slabs_partial)) {
+		/* no empty slab : grow cache */
+		if (list_empty(&cache->slabs_free) && kmem_cache_grow(cache))
+			return NULL;
+
+		/* move empty slab to partial list */
+		slab = list_first_entry(&cache->slabs_free, struct slab, list);
+		list_del(&slab->list);
+		list_add(&slab->list, &cache->slabs_partial);
+	}
+
+	/* get first free object */
+	slab = list_first_entry(&cache->slabs_partial, struct slab, list);
+	obj = slab->s_mem + slab->free * cache->size;
+	slab->free = slab->bufctl[slab->free];
+	slab->inuse++;
+	cache->nr_active++;
+
+	/* slab is full */
+	if (slab->inuse == cache->num) {
+		list_del(&slab->list);
+		list_add(&slab->list, &cache->slabs_full);
+	}
+
+	return obj;
+}
+
+/*
+ * Free an object (slab is known).
+ */
+static void __kmem_cache_free(struct kmem_cache *cache, struct slab *slab, void *obj)
+{
+	uint32_t idx;
+
+	/* chain object */
+	idx = (obj - slab->s_mem) / cache->size;
+	slab->bufctl[idx] = slab->free;
+	slab->free = idx;
+	slab->inuse--;
+	cache->nr_active--;
+
+	/* move slab to empty or partial list */
+	if (!slab->inuse) {
+		list_del(&slab->list);
+		list_add(&slab->list, &cache->slabs_free);
+	} else if (slab->inuse == cache->num - 1) {
+		list_del(&slab->list);
+		list_add(&slab->list, &cache->slabs_partial);
+	}
+}
+
+/*
+ * Get the slab of an object.
+ */
+static struct slab *kmem_slab_of(void *obj)
+{
+	uint32_t page_idx;
+
+	/* slab objects live in kernel pages */
+	if ((uint32_t) obj < KPAGE_START || (uint32_t) obj >= KPAGE_END)
+		return NULL;
+
+	/* get page */
+	page_idx = MAP_NR((uint32_t) obj);
+	if (page_idx >= nr_pages)
+		return NULL;
+
+	return page_table[page_idx].slab;
+}
+
+/*
+ * Free an object.
+ */
+void kmem_cache_free(struct kmem_cache *cache, void *obj)
+{
+	struct slab *slab;
+
+	if (!obj)
+		return;
+
+	/* get slab */
+	slab = kmem_slab_of(obj);
+	if (!slab || slab->cache != cache) {
+		printf("kmem_cache_free : bad object %x in cache %s\n", (uint32_t) obj, cache->name);
+		return;
+	}
+
+	__kmem_cache_free(cache, slab, obj);
+}
+
+/*
+ * Free an object allocated by kmalloc (returns -EINVAL if object is not a slab object).
+ */
+int kmem_free(void *obj)
+{
+	struct slab *slab;
+
+	/* get slab */
+	slab = kmem_slab_of(obj);
+	if (!slab)
+		return -EINVAL;
+
+	__kmem_cache_free(slab->cache, slab, obj);
+	return 0;
+}
+
+/*
+ * Get the tag of an object allocated by kmalloc (free chain slot is unused while the object is allocated).
+ */
+uint16_t *kmem_obj_tag(void *obj, size_t *size)
+{
+	struct slab *slab;
+	size_t i;
+
+	/* get slab */
+	slab = kmem_slab_of(obj);
+	if (!slab)
+		return NULL;
+
+	/* only kmalloc objects are tagged */
+	for (i = 0; i < NR_SIZE_CACHES; i++) {
+		if (slab->cache == size_caches[i]) {
+			*size = slab->cache->size;
+			return &slab->bufctl[(obj - slab->s_mem) / slab->cache->size];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Release empty slabs of a cache.
+ */
+int kmem_cache_shrink(struct kmem_cache *cache)
+{
+	struct list_head *pos, *n;
+	int ret = 0;
+
+	list_for_each_safe(pos, n, &cache->slabs_free) {
+		kmem_slab_destroy(cache, list_entry(pos, struct slab, list));
+		ret++;
+	}
+
+	return ret;
+}
+
+/*
+ * Release empty slabs of all caches (called when memory is low).
+ */
+void kmem_cache_reap()
+{
+	struct list_head *pos;
+
+	list_for_each(pos, &cache_list)
+		kmem_cache_shrink(list_entry(pos, struct kmem_cache, list));
+}
+
+/*
+ * Get kmalloc cache matching a size.
+ */
+struct kmem_cache *kmalloc_cache(size_t size)
+{
+	size_t i;
+
+	if (!size_caches_ready)
+		return NULL;
+
+	for (i = 0; i < NR_SIZE_CACHES; i++)
+		if (size <= size_caches_sizes[i])
+			return size_caches[i];
+
+	return NULL;
+}
+
+/*
+ * Get slab informations.
+ */
+int get_slabinfo(char *buf, int count)
+{
+	struct kmem_cache *cache;
+	struct list_head *pos;
+	int len;
+
+	/* print header */
+	len = sprintf(buf, "# name\tactive_objs\tnum_objs\tobjsize\tobjperslab\tnum_slabs\n");
+
+	list_for_each(pos, &cache_list) {
+		/* check overflow */
+		if (len >= count - 80)
+			break;
+
+		cache = list_entry(pos, struct kmem_cache, list);
+		len += sprintf(buf + len, "%s\t%u\t%u\t%u\t%u\t%u\n",
+			       cache->name,
+			       cache->nr_active,
+			       cache->nr_slabs * cache->num,
+			       cache->size,
+			       cache->num,
+			       cache->nr_slabs);
+	}
+
+	return len;
+}
+
+/*
+ * Init slab allocator.
+ */
+int init_slab()
+{
+	size_t i;
+
+	/* init cache of caches */
+	kmem_cache_setup(&cache_cache, "kmem_cache", sizeof(struct kmem_cache), NULL);
+
+	/* create kmalloc caches */
+	for (i = 0; i < NR_SIZE_CACHES; i++) {
+		size_caches[i] = kmem_cache_create(size_caches_names[i], size_caches_sizes[i], NULL);
+		if (!size_caches[i])
+			return -ENOMEM;
+	}
+
+	/* kmalloc can now use caches */
+	size_caches_ready = 1;
+
+	return 0;
+}
@@ -0,0 +1,576 @@
+#include <mm/swap.h>
+#include <mm/mm.h>
+#include <proc/sched.h>
+#include <kernel_stat.h>
+#include <x86/interrupt.h>
+#include <string.h>
+#include <stderr.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dev.h>
+
+#define SWAP_MAGIC			"SWAPSPACE2"
+#define SWAP_MAGIC_LEN			10
+
+/* swap areas */
+static struct swap_info swap_info[MAX_SWAPFILES];
+static int nr_swapfiles = 0;
+uint32_t nr_swap_pages = 0;
+uint32_t total_swap_pages = 0;
+
+/* swap cache (swapped pages are kept in page cache, indexed by swap entry) */
+static struct inode swapper_inode = {
+	.i_pages	= LIST_HEAD_INIT(swapper_inode.i_pages),
+};
+
+/*
+ * Get a swap area from an entry.
+ */
+static struct swap_info *swap_info_of(uint32_t entry)
+{
+	struct swap_info *si;
+
+	/* check type */
+	if (SWP_TYPE(entry) >= (uint32_t) nr_swapfiles)
+		return NULL;
+
+	/* check area */
+	si = &swap_info[SWP_TYPE(entry)];
+	if (!(si->flags & SWP_USED) || SWP_OFFSET(entry) >= si->max)
+		return NULL;
+
+	return si;
+}
+
+/*
+ * Allocate a swap slot (returns 0 if swap is full).
+ */
+uint32_t get_swap_page()
+{
+	struct swap_info *si;
+	uint32_t offset;
+	int type;
+
+	for (type = 0; type < nr_swapfiles; type++) {
+		si = &swap_info[type];
+		if ((si->flags & SWP_WRITEOK) != SWP_WRITEOK)
+			continue;
+
+		/* find a free slot */
+		for (offset = si->lowest_bit; offset <= si->highest_bit; offset++) {
+			if (si->swap_map[offset])
+				continue;
+
+			/* use slot */
+			si->swap_map[offset] = 1;
+			si->inuse_pages++;
+			nr_swap_pages--;
+
+			/* update free slots range */
+			if (offset == si->lowest_bit)
+				si->lowest_bit++;
+			if (offset == si->highest_bit)
+				si->highest_bit--;
+
+			return SWP_ENTRY(type, offset);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Release a swap entry (the slot is freed when last reference is dropped).
+ */
+void swap_free(uint32_t entry)
+{
+	struct swap_info *si;
+	uint32_t offset;
+	struct page *page;
+
+	/* get swap area */
+	si = swap_info_of(entry);
+	if (!si) {
+		printf("swap_free : bad swap entry %x\n", entry);
+		return;
+	}
+
+	/* bad or unused slot */
+	offset = SWP_OFFSET(entry);
+	if (!si->swap_map[offset] || si->swap_map[offset] == SWAP_MAP_BAD)
+		return;
+
+	/* still used */
+	if (si->swap_map[offset] < SWAP_MAP_MAX && --si->swap_map[offset])
+		return;
+
+	/* free slot */
+	si->swap_map[offset] = 0;
+	si->inuse_pages--;
+	nr_swap_pages++;
+
+	/* update free slots range */
+	if (offset < si->lowest_bit)
+		si->lowest_bit = offset;
+	if (offset > si->highest_bit)
+		si->highest_bit = offset;
+
+	/* slot can be reused : drop cached copy */
+	page = lookup_swap_cache(entry);
+	if (page) {
+		delete_from_swap_cache(page);
+		__free_page(page);
+	}
+}
+
+/*
+ * Add a reference to a swap entry.
+ */
+void swap_duplicate(uint32_t entry)
+{
+	struct swap_info *si;
+	uint32_t offset;
+
+	/* get swap area */
+	si = swap_info_of(entry);
+	if (!si) {
+		printf("swap_duplicate : bad swap entry %x\n", entry);
+		return;
+	}
+
+	/* update slot usage (counter sticks at max) */
+	offset = SWP_OFFSET(entry);
+	if (si->swap_map[offset] && si->swap_map[offset] < SWAP_MAP_MAX)
+		si->swap_map[offset]++;
+}
+
+/*
+ * Get a disk block of a swap area page.
+ */
+static int swap_bmap(struct swap_info *si, uint32_t offset, int i, dev_t *dev)
+{
+	uint32_t block = offset * (PAGE_SIZE / si->blocksize) + i;
+
+	/* block device */
+	if (si->swap_device) {
+		*dev = si->swap_device;
+		return block;
+	}
+
+	/* swap file */
+	*dev = si->swap_file->i_sb->s_dev;
+	return si->swap_file->i_op->bmap(si->swap_file, block);
+}
+
+/*
+ * Read/write a page from/to a swap area.
+ */
+static int __rw_swap_page(struct swap_info *si, int rw, uint32_t offset, void *buf)
+{
+	struct buffer_head *bh;
+	int i, block, ret;
+	dev_t dev;
+
+	for (i = 0; i < (int) (PAGE_SIZE / si->blocksize); i++, buf += si->blocksize) {
+		/* get disk block */
+		block = swap_bmap(si, offset, i, &dev);
+		if (block <= 0 && !si->swap_device)
+			return -EIO;
+
+		/* read block */
+		if (rw == SWAP_READ) {
+			bh = bread(dev, block, si->blocksize);
+			if (!bh)
+				return -EIO;
+
+			memcpy(buf, bh->b_data, si->blocksize);
+			brelse(bh);
+			continue;
+		}
+
+		/* write block */
+		bh = getblk(dev, block, si->blocksize);
+		if (!bh)
+			return -EIO;
+
+		memcpy(bh->b_data, buf, si->blocksize);
+		bh->b_uptodate = 1;
+		ret = bwrite(bh);
+		brelse(bh);
+
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Read/write a page from/to swap.
+ */
+int rw_swap_page(int rw, uint32_t entry, struct page *page)
+{
+	struct swap_info *si;
+	int ret;
+
+	/* get swap area */
+	si = swap_info_of(entry);
+	if (!si)
+		return -EINVAL;
+
+	/* bad slot */
+	if (si->swap_map[SWP_OFFSET(entry)] == SWAP_MAP_BAD)
+		return -EIO;
+
+	/* do I/O */
+	ret = __rw_swap_page(si, rw, SWP_OFFSET(entry), (void *) PAGE_ADDRESS(page));
+	if (ret)
+		return ret;
+
+	/* update statistics */
+	if (rw == SWAP_READ)
+		kstat.pswpin++;
+	else
+		kstat.pswpout++;
+
+	return 0;
+}
+
+/*
+ * Find a page in swap cache (a reference is taken on the page).
+ */
+struct page *lookup_swap_cache(uint32_t entry)
+{
+	return find_page(&swapper_inode, entry);
+}
+
+/*
+ * Is a swap entry in swap cache ?
+ */
+int in_swap_cache(uint32_t entry)
+{
+	return __find_page(&swapper_inode, entry) != NULL;
+}
+
+/*
+ * Add a page to swap cache.
+ */
+void add_to_swap_cache(struct page *page, uint32_t entry)
+{
+	add_to_page_cache(page, &swapper_inode, entry);
+}
+
+/*
+ * Remove a page from swap cache (drops swap cache reference).
+ */
+void delete_from_swap_cache(struct page *page)
+{
+	if (page->inode != &swapper_inode)
+		return;
+
+	htable_delete(&page->htable);
+	page->inode = NULL;
+	page->offset = 0;
+	__free_page(page);
+}
+
+/*
+ * Is a page in swap cache ?
+ */
+int is_swap_cache_page(struct page *page)
+{
+	return page->inode == &swapper_inode;
+}
+
+/*
+ * Swap in all pages of a swap area (called on swapoff).
+ */
+static int try_to_unuse(int type)
+{
+	struct list_head *pos_task, *pos_vma;
+	uint32_t address, *pte;
+	struct vm_area *vma;
+	struct task *task;
+	int ret;
+
+	list_for_each(pos_task, &tasks_list) {
+		task = list_entry(pos_task, struct task, list);
+		if (!task->mm || !task->mm->pgd)
+			continue;
+
+		list_for_each(pos_vma, &task->mm->vm_list) {
+			vma = list_entry(pos_vma, struct vm_area, list);
+
+			for (address = vma->vm_start; address < vma->vm_end; address += PAGE_SIZE) {
+				/* no page table */
+				if (!task->mm->pgd->tables[address >> 22])
+					continue;
+
+				/* swap entry of this area : swap page in */
+				pte = &task->mm->pgd->tables[address >> 22]->pages[(address >> PAGE_SHIFT) & 0x3FF];
+				if (PTE_SWAP(*pte) && SWP_TYPE(*pte) == (uint32_t) type) {
+					ret = do_swap_page(vma, address, pte);
+					if (ret)
+						return ret;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Get swap areas informations.
+ */
+int get_swaps(char *buf, int count)
+{
+	struct swap_info *si;
+	int len, i;
+
+	/* print header */
+	len = sprintf(buf, "Filename\t\t\t\tType\t\tSize\tUsed\tPriority\n");
+
+	for (i = 0; i < nr_swapfiles; i++) {
+		si = &swap_info[i];
+		if (!(si->flags & SWP_USED))
+			continue;
+
+		/* check overflow */
+		if (len + strlen(si->name) >= (size_t) count - 64)
+			break;
+
+		len += sprintf(buf + len, "%s\t\t\t\t%s\t%u\t%u\t-1\n",
+			       si->name,
+			       si->swap_device ? "partition" : "file\t",
+			       (si->max - 1) * (PAGE_SIZE / 1024),
+			       si->inuse_pages * (PAGE_SIZE / 1024));
+	}
+
+	return len;
+}
+
+/*
+ * Read swap header and set up slots map.
+ */
+static int setup_swap_map(struct swap_info *si)
+{
+	union swap_header *header;
+	uint32_t i, max;
+	int ret;
+
+	/* allocate header page */
+	header = get_free_page();
+	if (!header)
+		return -ENOMEM;
+
+	/* read header */
+	ret = __rw_swap_page(si, SWAP_READ, 0, header);
+	if (ret)
+		goto out;
+
+	/* check header */
+	ret = -EINVAL;
+	if (memcmp(header->magic.magic, SWAP_MAGIC, SWAP_MAGIC_LEN) != 0 || header->info.version != 1) {
+		printf("Unable to find swap space signature\n");
+		goto out;
+	}
+
+	/* compute number of slots */
+	max = header->info.last_page + 1;
+	if (!si->swap_device && max > si->swap_file->i_size / PAGE_SIZE)
+		max = si->swap_file->i_size / PAGE_SIZE;
+	if (max < 2 || header->info.nr_badpages > max)
+		goto out;
+
+	/* allocate slots map */
+	ret = -ENOMEM;
+	si->swap_map = (uint8_t *) kmalloc(max);
+	if (!si->swap_map)
+		goto out;
+	memset(si->swap_map, 0, max);
+
+	/* header page and bad pages can't be used */
+	si->swap_map[0] = SWAP_MAP_BAD;
+	for (i = 0; i < header->info.nr_badpages; i++)
+		if (header->info.badpages[i] > 0 && header->info.badpages[i] < max)
+			si->swap_map[header->info.badpages[i]] = SWAP_MAP_BAD;
+
+	/* swap files must not have holes */
+	ret = -EINVAL;
+	for (i = 1; !si->swap_device && i < max * (PAGE_SIZE / si->blocksize); i++) {
+		if (si->swap_file->i_op->bmap(si->swap_file, i) <= 0) {
+			printf("Swap file has holes\n");
+			kfree(si->swap_map);
+			si->swap_map = NULL;
+			goto out;
+		}
+	}
+
+	/* set slots */
+	si->max = max;
+	si->lowest_bit = 1;
+	si->highest_bit = max - 1;
+	si->inuse_pages = 0;
+	for (i = 1; i < max; i++) {
+		if (si->swap_map[i] != SWAP_MAP_BAD) {
+			nr_swap_pages++;
+			total_swap_pages++;
+		}
+	}
+
+	ret = 0;
+out:
+	free_page(header);
+	return ret;
+}
+
+/*
+ * Swapon system call.
+ */
+int sys_swapon(const char *path, int swap_flags)
+{
+	struct swap_info *si;
+	struct inode *inode;
+	int type, ret;
+
+	UNUSED(swap_flags);
+
+	/* only root can add swap */
+	if (current_task->euid != 0)
+		return -EPERM;
+
+	/* find a free swap area */
+	for (type = 0; type < MAX_SWAPFILES; type++)
+		if (!(swap_info[type].flags & SWP_USED))
+			break;
+	if (type >= MAX_SWAPFILES)
+		return -EPERM;
+
+	/* get inode */
+	inode = namei(AT_FDCWD, NULL, path, 1);
+	if (!inode)
+		return -ENOENT;
+
+	/* check if already used */
+	for (si = swap_info; si < swap_info + nr_swapfiles; si++) {
+		if ((si->flags & SWP_USED) && si->swap_file == inode) {
+			ret = -EBUSY;
+			goto err;
+		}
+	}
+
+	/* set swap area */
+	si = &swap_info[type];
+	memset(si, 0, sizeof(struct swap_info));
+	si->swap_file = inode;
+	si->max = 1;
+
+	if (S_ISBLK(inode->i_mode)) {
+		/* block device */
+		ret = -EINVAL;
+		si->swap_device = inode->i_rdev;
+		if (!blocksize_size[major(inode->i_rdev)])
+			goto err;
+		si->blocksize = blocksize_size[major(inode->i_rdev)][minor(inode->i_rdev)];
+	} else if (S_ISREG(inode->i_mode)) {
+		/* swap file */
+		ret = -EINVAL;
+		if (!inode->i_sb || !inode->i_op || !inode->i_op->bmap)
+			goto err;
+		si->blocksize = inode->i_sb->s_blocksize;
+	} else {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	/* check block size */
+	if (!si->blocksize || si->blocksize > PAGE_SIZE)
+		goto err;
+
+	/* read header */
+	ret = setup_swap_map(si);
+	if (ret)
+		goto err;
+
+	/* copy name */
+	si->name = (char *) kmalloc(strlen(path) + 1);
+	if (!si->name) {
+		ret = -ENOMEM;
+		goto err_map;
+	}
+	strcpy(si->name, path);
+
+	/* swap area can be used */
+	si->flags = SWP_WRITEOK;
+	if (type >= nr_swapfiles)
+		nr_swapfiles = type + 1;
+
+	printf("Adding swap: %uk swap-space\n", (si->max - 1) * (PAGE_SIZE / 1024));
+	return 0;
+err_map:
+	kfree(si->swap_map);
+err:
+	memset(&swap_info[type], 0, sizeof(struct swap_info));
+	iput(inode);
+	return ret;
+}
+
+/*
+ * Swapoff system call.
+ */
+int sys_swapoff(const char *path)
+{
+	struct swap_info *si = NULL;
+	struct inode *inode;
+	uint32_t i;
+	int type, ret;
+
+	/* only root can remove swap */
+	if (current_task->euid != 0)
+		return -EPERM;
+
+	/* get inode */
+	inode = namei(AT_FDCWD, NULL, path, 1);
+	if (!inode)
+		return -ENOENT;
+
+	/* find swap area */
+	for (type = 0; type < nr_swapfiles; type++) {
+		if ((swap_info[type].flags & SWP_WRITEOK) == SWP_WRITEOK && swap_info[type].swap_file == inode) {
+			si = &swap_info[type];
+			break;
+		}
+	}
+
+	/* release inode */
+	iput(inode);
+	if (!si)
+		return -EINVAL;
+
+	/* don't use this area anymore */
+	si->flags = SWP_USED;
+
+	/* swap in all pages */
+	ret = try_to_unuse(type);
+	if (ret || si->inuse_pages) {
+		si->flags = SWP_WRITEOK;
+		return ret ? ret : -EBUSY;
+	}
+
+	/* update number of free swap pages */
+	for (i = 1; i < si->max; i++) {
+		if (si->swap_map[i] != SWAP_MAP_BAD) {
+			nr_swap_pages--;
+			total_swap_pages--;
+		}
+	}
+
+	/* free swap area */
+	iput(si->swap_file);
+	kfree(si->swap_map);
+	kfree(si->name);
+	memset(si, 0, sizeof(struct swap_info));
+
+	return 0;
+}
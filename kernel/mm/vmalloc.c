@@ -0,0 +1,209 @@
+#include <mm/vmalloc.h>
+#include <mm/mm.h>
+#include <mm/paging.h>
+#include <stderr.h>
+#include <string.h>
+#include <stdio.h>
+
+/* vmalloc area (after kernel pages) */
+uint32_t vmalloc_start = 0;
+uint32_t vmalloc_end = 0;
+
+/* number of pages mapped in vmalloc area */
+uint32_t nr_vmalloc_pages = 0;
+
+/* allocated areas */
+static struct vm_struct *vmlist = NULL;
+
+/*
+ * Find a free virtual area (a guard page is left after each area).
+ */
+static struct vm_struct *get_vm_area(size_t size)
+{
+	struct vm_struct **p, *tmp, *area;
+	uint32_t addr;
+
+	/* allocate a new area */
+	area = (struct vm_struct *) kmalloc(sizeof(struct vm_struct));
+	if (!area)
+		return NULL;
+
+	/* add guard page */
+	size += PAGE_SIZE;
+
+	/* find first hole */
+	addr = vmalloc_start;
+	for (p = &vmlist; (tmp = *p) != NULL; p = &tmp->next) {
+		if (size + addr <= tmp->addr)
+			break;
+
+		addr = tmp->addr + tmp->size;
+	}
+
+	/* no space left */
+	if (addr + size < addr || addr + size > vmalloc_end) {
+		kfree(area);
+		return NULL;
+	}
+
+	/* insert area */
+	area->addr = addr;
+	area->size = size;
+	area->tag = 0;
+	area->next = *p;
+	*p = area;
+
+	return area;
+}
+
+/*
+ * Unmap and free pages of an area.
+ */
+static void vmfree_area_pages(uint32_t start, size_t size)
+{
+	uint32_t address, page_idx, *pte;
+
+	for (address = start; address < start + size; address += PAGE_SIZE) {
+		/* get page table entry (page tables are allocated at init) */
+		pte = &kernel_pgd->tables[address >> 22]->pages[(address >> PAGE_SHIFT) & 0x3FF];
+		page_idx = PTE_PAGE(*pte);
+		if (!page_idx)
+			continue;
+
+		/* free page */
+		*pte = 0;
+		flush_tlb(address);
+		__free_page(&page_table[page_idx]);
+		nr_vmalloc_pages--;
+	}
+}
+
+/*
+ * Map new pages in an area.
+ */
+static int vmalloc_area_pages(uint32_t start, size_t size)
+{
+	uint32_t address, *pte;
+	struct page *page;
+
+	for (address = start; address < start + size; address += PAGE_SIZE) {
+		/* get a free page */
+		page = __get_free_page();
+		if (!page)
+			return -ENOMEM;
+
+		/* set page table entry */
+		pte = &kernel_pgd->tables[address >> 22]->pages[(address >> PAGE_SHIFT) & 0x3FF];
+		*pte = MK_PTE(page->page, PAGE_KERNEL);
+		nr_vmalloc_pages++;
+	}
+
+	return 0;
+}
+
+/*
+ * Allocate virtually contiguous memory.
+ */
+void *vmalloc(size_t size)
+{
+	struct vm_struct *area;
+
+	/* check size */
+	size = PAGE_ALIGN_UP(size);
+	if (!size || size > vmalloc_end - vmalloc_start)
+		return NULL;
+
+	/* get a virtual area */
+	area = get_vm_area(size);
+	if (!area)
+		return NULL;
+
+	/* map pages */
+	if (vmalloc_area_pages(area->addr, size)) {
+		vfree((void *) area->addr);
+		return NULL;
+	}
+
+	return (void *) area->addr;
+}
+
+/*
+ * Free virtually contiguous memory.
+ */
+void vfree(void *addr)
+{
+	struct vm_struct **p, *tmp;
+
+	if (!addr)
+		return;
+
+	/* check alignment */
+	if (!PAGE_ALIGNED((uint32_t) addr)) {
+		printf("vfree : bad address %x\n", (uint32_t) addr);
+		return;
+	}
+
+	/* find area */
+	for (p = &vmlist; (tmp = *p) != NULL; p = &tmp->next) {
+		if (tmp->addr != (uint32_t) addr)
+			continue;
+
+		/* unlink area and free pages (except guard page) */
+		*p = tmp->next;
+		vmfree_area_pages(tmp->addr, tmp->size - PAGE_SIZE);
+		kfree(tmp);
+		return;
+	}
+
+	printf("vfree : bad address %x\n", (uint32_t) addr);
+}
+
+/*
+ * Find the area starting at an address.
+ */
+struct vm_struct *find_vm_area(void *addr)
+{
+	struct vm_struct *tmp;
+
+	for (tmp = vmlist; tmp != NULL; tmp = tmp->next)
+		if (tmp->addr == (uint32_t) addr)
+			return tmp;
+
+	return NULL;
+}
+
+/*
+ * Init vmalloc area.
+ */
+int init_vmalloc()
+{
+	uint32_t address, size, idx;
+
+	/* vmalloc area starts after kernel pages */
+	vmalloc_start = ALIGN_UP(KPAGE_START + nr_pages * PAGE_SIZE, HPAGE_SIZE) + VMALLOC_OFFSET;
+	if (vmalloc_start < KPAGE_START || vmalloc_start >= KPAGE_END) {
+		vmalloc_start = vmalloc_end = 0;
+		return 0;
+	}
+
+	/* area size scales with installed memory */
+	size = ALIGN_UP(nr_pages * PAGE_SIZE, HPAGE_SIZE);
+	if (size > VMALLOC_MAX_SIZE)
+		size = VMALLOC_MAX_SIZE;
+	if (size > KPAGE_END - vmalloc_start)
+		size = KPAGE_END - vmalloc_start;
+	vmalloc_end = vmalloc_start + size;
+
+	/* allocate page tables now : they will be linked in all page directories */
+	for (address = vmalloc_start; address < vmalloc_end; address += HPAGE_SIZE) {
+		idx = address >> HPAGE_SHIFT;
+		kernel_pgd->tables[idx] = (struct page_table *) kmalloc_align(sizeof(struct page_table));
+		if (!kernel_pgd->tables[idx])
+			return -ENOMEM;
+
+		memset(kernel_pgd->tables[idx], 0, PAGE_SIZE);
+		kernel_pgd->tables_physical[idx] = (uint32_t) kernel_pgd->tables[idx] | PAGE_PRESENT | PAGE_RW;
+	}
+
+	return 0;
+}
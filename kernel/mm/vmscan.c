@@ -0,0 +1,449 @@
+#include <mm/mm.h>
+#include <mm/paging.h>
+#include <mm/slab.h>
+#include <mm/swap.h>
+#include <fs/fs.h>
+#include <proc/sched.h>
+#include <kernel_stat.h>
+#include <stderr.h>
+#include <time.h>
+#include <stdio.h>
+
+#define RECLAIM_BATCH			32
+#define RECLAIM_PRIORITY		6
+#define KSWAPD_FREQ_MS			1000
+#define FREEPAGES_MIN			16
+
+/* LRU lists */
+static LIST_HEAD(active_list);
+static LIST_HEAD(inactive_list);
+uint32_t nr_active_pages = 0;
+uint32_t nr_inactive_pages = 0;
+
+/* free pages watermarks */
+struct freepages freepages = { 0, 0, 0 };
+
+/* swap out scan position (kept between calls : tasks are scanned in turn) */
+static struct task *swap_task = NULL;
+static uint32_t swap_address = 0;
+
+/* page reclaim daemon */
+static struct task *kswapd_task = NULL;
+static struct wait_queue *kswapd_wait = NULL;
+
+/*
+ * Add a page to LRU lists (new pages start on inactive list).
+ */
+void lru_cache_add(struct page *page)
+{
+	/* already on LRU lists */
+	if (page->lru.next)
+		return;
+
+	page->active = 0;
+	page->referenced = 0;
+	list_add(&page->lru, &inactive_list);
+	nr_inactive_pages++;
+}
+
+/*
+ * Remove a page from LRU lists.
+ */
+void lru_cache_del(struct page *page)
+{
+	/* not on LRU lists */
+	if (!page->lru.next)
+		return;
+
+	list_del(&page->lru);
+	if (page->active)
+		nr_active_pages--;
+	else
+		nr_inactive_pages--;
+
+	page->active = 0;
+	page->referenced = 0;
+}
+
+/*
+ * Move a page to active list.
+ */
+static void activate_page(struct page *page)
+{
+	list_del(&page->lru);
+	list_add(&page->lru, &active_list);
+	nr_inactive_pages--;
+	nr_active_pages++;
+	page->active = 1;
+	page->referenced = 0;
+}
+
+/*
+ * Move a page to inactive list.
+ */
+static void deactivate_page(struct page *page)
+{
+	list_del(&page->lru);
+	list_add(&page->lru, &inactive_list);
+	nr_active_pages--;
+	nr_inactive_pages++;
+	page->active = 0;
+	page->referenced = 0;
+}
+
+/*
+ * Mark a page accessed (second access on inactive list activates it).
+ */
+void mark_page_accessed(struct page *page)
+{
+	/* not on LRU lists */
+	if (!page->lru.next)
+		return;
+
+	if (!page->active && page->referenced)
+		activate_page(page);
+	else
+		page->referenced = 1;
+}
+
+/*
+ * Move cold pages from the tail of active list to inactive list.
+ */
+static void refill_inactive(uint32_t nr_to_scan)
+{
+	struct page *page;
+
+	while (nr_to_scan-- > 0 && !list_empty(&active_list)) {
+		page = list_entry(active_list.prev, struct page, lru);
+
+		/* referenced page : give it a second chance */
+		if (page->referenced) {
+			page->referenced = 0;
+			list_del(&page->lru);
+			list_add(&page->lru, &active_list);
+			continue;
+		}
+
+		deactivate_page(page);
+	}
+}
+
+/*
+ * Try to free a cached page (returns 1 if the page has been freed).
+ */
+static int try_to_free_page(struct page *page)
+{
+	/* used page */
+	if (page->count > 1)
+		return 0;
+
+	/* page cache page (shared memory pages can't be dropped, dirty pages must be written back first) */
+	if (page->inode) {
+		if (page->inode->i_shm == 1 || !try_to_free_page_buffers(page))
+			return 0;
+
+		htable_delete(&page->htable);
+		__free_page(page);
+		return 1;
+	}
+
+	/* buffer cache page */
+	if (page->buffers)
+		return try_to_free_buffer(page->buffers);
+
+	return 0;
+}
+
+/*
+ * Free up to nr_to_free pages from the tail of inactive list.
+ */
+static int shrink_cache(uint32_t nr_to_free, uint32_t nr_to_scan, int priority)
+{
+	struct page *page;
+	uint32_t nr_freed = 0;
+
+	while (nr_to_scan-- > 0 && nr_freed < nr_to_free && !list_empty(&inactive_list)) {
+		page = list_entry(inactive_list.prev, struct page, lru);
+		kstat.pgscan++;
+
+		/* referenced page : activate it (last pass frees it anyway) */
+		if (page->referenced && priority) {
+			activate_page(page);
+			continue;
+		}
+
+		/* rotate page (if it can't be freed, it will be scanned last next time) */
+		list_del(&page->lru);
+		list_add(&page->lru, &inactive_list);
+
+		/* try to free page */
+		if (try_to_free_page(page)) {
+			kstat.pgsteal++;
+			nr_freed++;
+		}
+	}
+
+	return nr_freed;
+}
+
+/*
+ * Reclaim a batch of cold pages.
+ */
+int reclaim_pages()
+{
+	uint32_t nr_freed = 0;
+	int priority;
+
+	/* release empty slabs */
+	kmem_cache_reap();
+
+	/* scan a bigger part of LRU lists at each pass */
+	for (priority = RECLAIM_PRIORITY; priority >= 0; priority--) {
+		/* keep inactive list at least as big as active list */
+		if (nr_inactive_pages < nr_active_pages)
+			refill_inactive((nr_active_pages >> priority) + 1);
+
+		/* free inactive pages */
+		nr_freed += shrink_cache(RECLAIM_BATCH - nr_freed, (nr_inactive_pages >> priority) + 1, priority);
+		if (nr_freed >= RECLAIM_BATCH)
+			break;
+	}
+
+	return nr_freed;
+}
+
+/*
+ * Try to swap out a page table entry (page is moved to swap cache, returns the page if it must be written).
+ */
+static struct page *try_to_swap_out(uint32_t *pte)
+{
+	struct page *page;
+	uint32_t entry;
+
+	/* no page */
+	if (!(*pte & PAGE_PRESENT) || !PTE_PAGE(*pte) || PTE_PAGE(*pte) >= nr_pages)
+		return NULL;
+
+	/* recently accessed page : give it a second chance */
+	if (*pte & PAGE_ACCESSED) {
+		*pte &= ~PAGE_ACCESSED;
+		return NULL;
+	}
+
+	/* only private anonymous pages can be swapped */
+	page = &page_table[PTE_PAGE(*pte)];
+	if (page->count != 1 || page->inode || page->buffers || page->slab)
+		return NULL;
+
+	/* get a swap slot */
+	entry = get_swap_page();
+	if (!entry)
+		return NULL;
+
+	/* replace page by swap entry and keep page in swap cache until it is written (page table reference is kept for I/O) */
+	*pte = entry;
+	add_to_swap_cache(page, entry);
+
+	return page;
+}
+
+/*
+ * Get task at swap out scan position (restart from first task if it exited).
+ */
+static struct task *swap_out_task()
+{
+	struct list_head *pos;
+
+	/* check task still exists */
+	list_for_each(pos, &tasks_list)
+		if (list_entry(pos, struct task, list) == swap_task)
+			return swap_task;
+
+	/* restart from first task */
+	swap_task = list_empty(&tasks_list) ? NULL : list_first_entry(&tasks_list, struct task, list);
+	swap_address = 0;
+	return swap_task;
+}
+
+/*
+ * Get first swappable memory region of a task ending after an address.
+ */
+static struct vm_area *swap_out_vma(struct task *task, uint32_t address)
+{
+	struct list_head *pos;
+	struct vm_area *vma;
+
+	/* kernel threads have no user memory */
+	if (!task->mm || !task->mm->pgd || task->mm->pgd == kernel_pgd)
+		return NULL;
+
+	list_for_each(pos, &task->mm->vm_list) {
+		vma = list_entry(pos, struct vm_area, list);
+
+		/* shared and huge page mappings are never swapped */
+		if (vma->vm_end > address && !(vma->vm_flags & (VM_SHARED | VM_HUGETLB)))
+			return vma;
+	}
+
+	return NULL;
+}
+
+/*
+ * Swap out cold anonymous pages of all tasks (scan resumes where last call stopped).
+ */
+int swap_out(uint32_t nr_to_swap)
+{
+	struct page *pages[SWAP_CLUSTER], *page;
+	uint32_t end, flags, nr_tasks = 1;
+	int nr = 0, nr_swapped = 0, nr_start, i;
+	struct list_head *pos;
+	struct page_table *pgt;
+	struct vm_area *vma;
+	struct task *task;
+
+	/* no swap */
+	if (!nr_swap_pages)
+		return 0;
+
+	/* limit batch */
+	if (nr_to_swap > SWAP_CLUSTER)
+		nr_to_swap = SWAP_CLUSTER;
+
+	/* scan each task at most once (plus start of current one) */
+	irq_save(flags);
+	list_for_each(pos, &tasks_list)
+		nr_tasks++;
+	irq_restore(flags);
+
+	/* select pages, one page table at a time (page tables must not change during scan) */
+	while ((uint32_t) nr < nr_to_swap && nr_swap_pages && nr_tasks) {
+		irq_save(flags);
+
+		/* find region at scan position */
+		task = swap_out_task();
+		vma = task ? swap_out_vma(task, swap_address) : NULL;
+
+		/* end of task : go to next one */
+		if (!vma) {
+			if (task)
+				swap_task = list_next_entry_or_null(task, &tasks_list, list);
+			swap_address = 0;
+			nr_tasks--;
+			irq_restore(flags);
+			continue;
+		}
+
+		/* scan region up to end of page table */
+		if (swap_address < vma->vm_start)
+			swap_address = vma->vm_start;
+		end = (swap_address & HPAGE_MASK) + HPAGE_SIZE;
+		if (end > vma->vm_end)
+			end = vma->vm_end;
+
+		/* no page table */
+		pgt = task->mm->pgd->tables[swap_address >> 22];
+		if (!pgt || pgt == kernel_pgd->tables[swap_address >> 22]) {
+			swap_address = end;
+			irq_restore(flags);
+			continue;
+		}
+
+		/* try to swap out pages */
+		for (nr_start = nr; swap_address < end && (uint32_t) nr < nr_to_swap && nr_swap_pages; swap_address += PAGE_SIZE) {
+			page = try_to_swap_out(&pgt->pages[(swap_address >> PAGE_SHIFT) & 0x3FF]);
+			if (page)
+				pages[nr++] = page;
+		}
+
+		/* page table entries have been replaced by swap entries */
+		if (nr != nr_start)
+			flush_tlb_all();
+
+		irq_restore(flags);
+	}
+
+	/* accessed bits have been cleared */
+	flush_tlb_all();
+
+	/* write pages */
+	for (i = 0; i < nr; i++) {
+		page = pages[i];
+
+		/* swap entry has been released meanwhile : nothing to write */
+		if (is_swap_cache_page(page)) {
+			/* on error, page is pinned in swap cache (swap in will find it there) */
+			if (rw_swap_page(SWAP_WRITE, page->offset, page)) {
+				printf("swap_out : write error\n");
+				continue;
+			}
+		}
+
+		/* page is not used anymore : free it now */
+		irq_save(flags);
+		if (page->count == 2 && is_swap_cache_page(page))
+			delete_from_swap_cache(page);
+		irq_restore(flags);
+
+		__free_page(page);
+		nr_swapped++;
+	}
+
+	return nr_swapped;
+}
+
+/*
+ * Wake up page reclaim daemon.
+ */
+void wakeup_kswapd()
+{
+	if (!kswapd_task || kswapd_task->state != TASK_SLEEPING)
+		return;
+
+	kstat.kswapd_wakeups++;
+	task_wakeup(&kswapd_wait);
+}
+
+/*
+ * Page reclaim daemon.
+ */
+static void kswapd(void *arg)
+{
+	UNUSED(arg);
+
+	for (;;) {
+		if (nr_free_pages() < freepages.high) {
+			/* write dirty buffers ahead of pressure (so that they can be reclaimed) */
+			bsync();
+
+			/* reclaim pages until high watermark (swap anonymous pages out if page cache is not enough) */
+			while (nr_free_pages() < freepages.high)
+				if (!reclaim_pages() && !swap_out(SWAP_CLUSTER))
+					break;
+		}
+
+		/* wait for low memory (or check periodically) */
+		current_task->timeout = jiffies + ms_to_jiffies(KSWAPD_FREQ_MS);
+		task_sleep(&kswapd_wait);
+		current_task->timeout = 0;
+	}
+}
+
+/*
+ * Init page reclaim daemon.
+ */
+int init_kswapd()
+{
+	/* set default watermarks */
+	freepages.min = nr_pages / 128;
+	if (freepages.min < FREEPAGES_MIN)
+		freepages.min = FREEPAGES_MIN;
+	freepages.low = freepages.min * 2;
+	freepages.high = freepages.min * 3;
+
+	/* create page reclaim daemon */
+	kswapd_task = create_kernel_thread(kswapd, NULL);
+	if (!kswapd_task)
+		return -ENOMEM;
+
+	return 0;
+}
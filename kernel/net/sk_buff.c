@@ -1,6 +1,23 @@
 #include <net/sk_buff.h>
 #include <mm/mm.h>
+#include <mm/slab.h>
 #include <string.h>
+#include <stderr.h>
+
+/* socket buffers cache */
+static struct kmem_cache *skbuff_cache = NULL;
+
+/*
+ * Init socket buffers.
+ */
+int init_skb()
+{
+	skbuff_cache = kmem_cache_create("sk_buff", sizeof(struct sk_buff), NULL);
+	if (!skbuff_cache)
+		return -ENOMEM;
+
+	return 0;
+}
 
 /*
  * Allocate a socket buffer.
@@ -11,7 +28,7 @@ struct sk_buff *skb_alloc(size_t size)
 	uint8_t *data;
 
 	/* allocate socket buffer */
-	skb = (struct sk_buff *) kmalloc(sizeof(struct sk_buff));
+	skb = (struct sk_buff *) kmem_cache_alloc(skbuff_cache);
 	if (!skb)
 		return NULL;
 	memset(skb, 0, sizeof(struct sk_buff));
@@ -20,7 +37,7 @@ struct sk_buff *skb_alloc(size_t size)
 	skb->size = size;
 	data = (uint8_t *) kmalloc(size);
 	if (!data) {
-		kfree(skb);
+		kmem_cache_free(skbuff_cache, skb);
 		return NULL;
 	}
 
@@ -62,6 +79,6 @@ struct sk_buff *skb_clone(struct sk_buff *skb)
 void skb_free(struct sk_buff *skb)
 {
 	kfree(skb->head);
-	kfree(skb);
+	kmem_cache_free(skbuff_cache, skb);
 }
 
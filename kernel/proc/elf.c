@@ -239,8 +239,8 @@ static int clear_old_exec()
 		task_release_mmap(current_task);
 		task_exit_mmap(current_task->mm);
 	} else {
-		/* duplicate mm struct */
-		mm_new = task_dup_mm(current_task->mm);
+		/* shared mm struct (vfork or thread) : allocate a new empty one, old regions are kept for other users */
+		mm_new = task_new_mm();
 		if (!mm_new) {
 			ret = -ENOMEM;
 			goto err_mm;
@@ -278,6 +278,9 @@ static int clear_old_exec()
 		}
 	}
 
+	/* reset FPU/SSE registers (default control word and MXCSR) */
+	fpu_reset(current_task);
+
 	return 0;
 err_mm:
 	if (sig_new)
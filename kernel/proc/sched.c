@@ -59,6 +59,11 @@ int init_scheduler(void (*kinit_func)())
 	/* reset kernel stats */
 	memset(&kstat, 0, sizeof(struct kernel_stat));
 
+	/* create tasks cache */
+	task_cache = kmem_cache_create("task", sizeof(struct task), NULL);
+	if (!task_cache)
+		return -ENOMEM;
+
 	/* create init task */
 	kinit_task = create_kernel_thread(kinit_func, NULL);
 	if (!kinit_task)
@@ -140,7 +145,14 @@ void schedule()
 		kstat.context_switch++;
 		tss_set_stack(0x10, current_task->kernel_stack);
 		load_tls();
-		switch_page_directory(current_task->mm->pgd);
+
+		/* kernel threads only use kernel mappings (same everywhere) : keep previous page directory loaded */
+		if (current_task->mm->pgd != kernel_pgd && current_task->mm->pgd != current_pgd)
+			switch_page_directory(current_task->mm->pgd);
+
+		/* FPU/SSE registers are switched on first use */
+		fpu_switch(current_task);
+
 		scheduler_do_switch(&prev_task->esp, current_task->esp);
 	}
 
@@ -11,6 +11,9 @@
 #include <stderr.h>
 #include <fcntl.h>
 
+/* tasks cache */
+struct kmem_cache *task_cache = NULL;
+
 /* switch to user mode (defined in x86/scheduler.s) */
 extern void enter_user_mode(uint32_t esp, uint32_t eip, uint32_t return_address);
 extern void return_user_mode(struct registers *regs);
@@ -140,6 +143,34 @@ static int task_copy_rlim(struct task *task, struct task *parent)
 	return 0;
 }
 
+/*
+ * Create a new empty memory structure (only kernel pages are mapped).
+ */
+struct mm_struct *task_new_mm()
+{
+	struct mm_struct *mm;
+
+	/* allocate memory structure */
+	mm = (struct mm_struct *) kmalloc(sizeof(struct mm_struct));
+	if (!mm)
+		return NULL;
+
+	/* init memory structure */
+	memset(mm, 0, sizeof(struct mm_struct));
+	mm->count = 1;
+	INIT_LIST_HEAD(&mm->vm_list);
+	mm->vm_rb = RB_ROOT;
+
+	/* link kernel page tables */
+	mm->pgd = clone_page_directory(kernel_pgd);
+	if (!mm->pgd) {
+		kfree(mm);
+		return NULL;
+	}
+
+	return mm;
+}
+
 /*
  * Duplicate a memory structure.
  */
@@ -158,6 +189,7 @@ struct mm_struct *task_dup_mm(struct mm_struct *mm)
 	memset(mm_new, 0, sizeof(struct mm_struct));
 	mm_new->count = 1;
 	INIT_LIST_HEAD(&mm_new->vm_list);
+	mm_new->vm_rb = RB_ROOT;
 
 	/* clone page directory */
 	mm_new->pgd = mm ? clone_page_directory(mm->pgd) : kernel_pgd;
@@ -174,7 +206,7 @@ struct mm_struct *task_dup_mm(struct mm_struct *mm)
 	if (mm) {
 		list_for_each(pos, &mm->vm_list) {
 			vm_parent = list_entry(pos, struct vm_area, list);
-			vm_child = (struct vm_area *) kmalloc(sizeof(struct vm_area));
+			vm_child = (struct vm_area *) kmem_cache_alloc(vm_area_cache);
 			if (!vm_child)
 				goto err;
 
@@ -187,7 +219,7 @@ struct mm_struct *task_dup_mm(struct mm_struct *mm)
 			vm_child->vm_offset = vm_parent->vm_offset;
 			vm_child->vm_inode = vm_parent->vm_inode;
 			vm_child->vm_ops = vm_parent->vm_ops;
-			list_add_tail(&vm_child->list, &mm_new->vm_list);
+			vma_link(mm_new, vm_child);
 
 			/* open region */
 			if (vm_child->vm_ops && vm_child->vm_ops->open)
@@ -407,9 +439,13 @@ void task_exit_mmap(struct mm_struct *mm)
 
 			/* free memory region */
 			list_del(&vm_area->list);
-			kfree(vm_area);
+			kmem_cache_free(vm_area_cache, vm_area);
 		}
 	}
+
+	/* all regions are gone */
+	mm->vm_rb = RB_ROOT;
+	mm->vm_cache = NULL;
 }
 
 /*
@@ -439,8 +475,10 @@ static void task_exit_mm(struct task *task)
  */
 void task_release_mmap(struct task *task)
 {
-	if (task->flags & CLONE_VFORK)
+	if (task->flags & CLONE_VFORK) {
+		task->flags &= ~CLONE_VFORK;
 		up(task->parent->vfork_sem);
+	}
 }
 
 /*
@@ -452,7 +490,7 @@ static struct task *create_task(struct task *parent, uint32_t clone_flags, uint3
 	void *stack;
 
 	/* create task */
-	task = (struct task *) kmalloc(sizeof(struct task));
+	task = (struct task *) kmem_cache_alloc(task_cache);
 	if (!task)
 		return NULL;
 
@@ -487,6 +525,9 @@ static struct task *create_task(struct task *parent, uint32_t clone_flags, uint3
 	INIT_LIST_HEAD(&task->list);
 	INIT_LIST_HEAD(&task->sig_tm.list);
 
+	/* inherit FPU/SSE registers */
+	fpu_copy(task, parent);
+
 	/* copy task name and TLS */
 	if (parent) {
 		memcpy(task->name, parent->name, TASK_NAME_LEN);
@@ -526,7 +567,7 @@ err_mm:
 err_flags:
 	kfree(stack);
 err_stack:
-	kfree(task);
+	kmem_cache_free(task_cache, task);
 	return NULL;
 }
 
@@ -581,13 +622,17 @@ int do_fork(uint32_t clone_flags, uint32_t user_sp)
 	regs->return_address = TASK_RETURN_ADDRESS;
 	regs->eip = (uint32_t) task_user_entry;
 
+	/* vfork : set semaphore before child can run */
+	if (clone_flags & CLONE_VFORK) {
+		init_semaphore(&sem, 0);
+		current_task->vfork_sem = &sem;
+	}
+
 	/* add new task */
 	list_add(&task->list, &current_task->list);
 
-	/* vfork : sleep on semaphore */
+	/* vfork : sleep until child releases memory (exec or exit) */
 	if (clone_flags & CLONE_VFORK) {
-		init_semaphore(&sem, 0);
-		current_task->vfork_sem = &sem;
 		down(&sem);
 		current_task->vfork_sem = NULL;
 	}
@@ -639,8 +684,11 @@ void destroy_task(struct task *task)
 	/* exit memory */
 	task_exit_mm(task);
 
+	/* release FPU/SSE registers */
+	fpu_release(task);
+
 	/* free task */
-	kfree(task);
+	kmem_cache_free(task_cache, task);
 }
 
 /*
@@ -652,11 +700,11 @@ pid_t sys_fork()
 }
 
 /*
- * Vfork system call..
+ * Vfork system call (share memory with parent, parent is suspended until child exec or exit).
  */
 pid_t sys_vfork()
 {
-	return sys_fork();
+	return do_fork(CLONE_VM | CLONE_VFORK, 0);
 }
 
 /*
@@ -1,6 +1,7 @@
 #include <sys/syscall.h>
 #include <proc/sched.h>
 #include <fs/fs.h>
+#include <mm/swap.h>
 #include <net/socket.h>
 #include <ipc/ipc.h>
 #include <sys/sys.h>
@@ -119,6 +120,8 @@ static const void *syscalls[] = {
 	[__NR_sync]			= sys_sync,
 	[__NR_chroot]			= sys_chroot,
 	[__NR_reboot]			= sys_reboot,
+	[__NR_swapon]			= sys_swapon,
+	[__NR_swapoff]			= sys_swapoff,
 	[__NR_mount]			= sys_mount,
 	[__NR_umount2]			= sys_umount2,
 	[__NR_statfs64]			= sys_statfs64,
@@ -132,6 +135,7 @@ static const void *syscalls[] = {
 	[__NR_fstat64]			= sys_fstat64,
 	[__NR_fstatat64]		= sys_fstatat64,
 	[__NR_fsync]			= sys_fsync,
+	[__NR_fdatasync]		= sys_fdatasync,
 	[__NR_fchdir]			= sys_fchdir,
 	[__NR_madvise]			= sys_madvise,
 	[__NR_clone]			= sys_clone,
@@ -0,0 +1,112 @@
+#include <x86/fpu.h>
+#include <x86/system.h>
+#include <x86/interrupt.h>
+#include <proc/sched.h>
+#include <mm/paging.h>
+#include <string.h>
+
+/* task whose FPU/SSE registers are loaded (registers are switched lazily, on first use) */
+static struct task *fpu_owner = NULL;
+
+/* FPU/SSE registers of a new program */
+static char fpu_init_state[FPU_STATE_SIZE + 16];
+
+/*
+ * Get initial FXSAVE area (16 bytes aligned).
+ */
+static inline void *fpu_init_area()
+{
+	return (void *) ALIGN_UP((uint32_t) fpu_init_state, 16);
+}
+
+/*
+ * Device not available handler (a task uses FPU/SSE registers after a switch : load them).
+ */
+static void fpu_handler(struct registers *regs)
+{
+	UNUSED(regs);
+
+	clts();
+
+	/* registers already loaded */
+	if (fpu_owner == current_task)
+		return;
+
+	/* save previous owner registers and load current ones */
+	if (fpu_owner)
+		fxsave(task_fpu_state(fpu_owner));
+	fxrstor(task_fpu_state(current_task));
+	fpu_owner = current_task;
+}
+
+/*
+ * Switch FPU/SSE registers (next task will fault on first use, unless it owns them).
+ */
+void fpu_switch(struct task *next)
+{
+	if (!sse2_enabled)
+		return;
+
+	if (next == fpu_owner)
+		clts();
+	else
+		stts();
+}
+
+/*
+ * Copy FPU/SSE registers of a parent task (or set initial registers if there is no parent).
+ */
+void fpu_copy(struct task *task, struct task *parent)
+{
+	if (!sse2_enabled)
+		return;
+
+	if (!parent)
+		memcpy(task_fpu_state(task), fpu_init_area(), FPU_STATE_SIZE);
+	else if (parent == fpu_owner)
+		fxsave(task_fpu_state(task));
+	else
+		memcpy(task_fpu_state(task), task_fpu_state(parent), FPU_STATE_SIZE);
+}
+
+/*
+ * Reset FPU/SSE registers of a task (new program).
+ */
+void fpu_reset(struct task *task)
+{
+	if (!sse2_enabled)
+		return;
+
+	/* drop loaded registers (next use will load initial ones) */
+	if (fpu_owner == task) {
+		fpu_owner = NULL;
+		stts();
+	}
+
+	memcpy(task_fpu_state(task), fpu_init_area(), FPU_STATE_SIZE);
+}
+
+/*
+ * Release FPU/SSE registers of a task.
+ */
+void fpu_release(struct task *task)
+{
+	if (fpu_owner == task)
+		fpu_owner = NULL;
+}
+
+/*
+ * Init FPU/SSE registers handling.
+ */
+void init_fpu()
+{
+	uint32_t mxcsr = MXCSR_DEFAULT;
+
+	/* build initial registers : default x87 control word and MXCSR, cleared xmm registers */
+	__asm__ __volatile__("fninit; ldmxcsr %0" :: "m" (mxcsr));
+	fxsave(fpu_init_area());
+	memset((char *) fpu_init_area() + 160, 0, 8 * 16);
+
+	/* load registers on first use after a task switch */
+	register_interrupt_handler(7, fpu_handler);
+}
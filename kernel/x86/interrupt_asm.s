@@ -85,6 +85,7 @@ extern isr_handler
 ; common isr handler
 isr_common_stub:
 	pusha			; save registers
+	cld			; string instructions go forward (interrupted code may have set direction flag)
 
 	mov ax, ds
 	push eax
@@ -1,30 +1,97 @@
-global copy_page_physical
+global copy_page_rep
+global clear_page_rep
+global copy_page_sse2
+global clear_page_sse2
 
-copy_page_physical:
-	push ebx			; save ebx and eflags
-	pushf
+copy_page_rep:
+	push esi			; save esi and edi
+	push edi
 
-	mov ebx, [esp+12]		; src address
-	mov ecx, [esp+16]		; dst address
+	mov edi, [esp+12]		; dst address
+	mov esi, [esp+16]		; src address
+	mov ecx, 1024			; 1024 * 4 bytes = 4096 bytes to copy
+	cld
+	rep movsd
 
-	mov edx, cr0			; disable paging
-	and edx, 0x7fffffff
-	mov cr0, edx
+	pop edi				; restore edi and esi
+	pop esi
+	ret
+
+clear_page_rep:
+	push edi			; save edi
+
+	mov edi, [esp+8]		; dst address
+	xor eax, eax
+	mov ecx, 1024			; 1024 * 4 bytes = 4096 bytes to clear
+	cld
+	rep stosd
+
+	pop edi				; restore edi
+	ret
+
+copy_page_sse2:
+	push esi			; save esi and edi
+	push edi
+
+	sub esp, 64			; save xmm0-xmm3 (they hold current task state, saved on task switch)
+	movdqu [esp], xmm0
+	movdqu [esp+16], xmm1
+	movdqu [esp+32], xmm2
+	movdqu [esp+48], xmm3
+
+	mov edi, [esp+76]		; dst address
+	mov esi, [esp+80]		; src address
+	mov ecx, 64			; 64 * 64 bytes = 4096 bytes to copy
+
+.loop:
+	movdqa xmm0, [esi]		; load 64 bytes
+	movdqa xmm1, [esi+16]
+	movdqa xmm2, [esi+32]
+	movdqa xmm3, [esi+48]
+	movntdq [edi], xmm0		; store them bypassing the cache
+	movntdq [edi+16], xmm1
+	movntdq [edi+32], xmm2
+	movntdq [edi+48], xmm3
+	add esi, 64
+	add edi, 64
+	dec ecx
+	jnz .loop
+
+	sfence				; order non temporal stores
 
-	mov edx, 1024			; 1024 * 4 bytes = 4096 bytes to copy
+	movdqu xmm0, [esp]		; restore xmm0-xmm3
+	movdqu xmm1, [esp+16]
+	movdqu xmm2, [esp+32]
+	movdqu xmm3, [esp+48]
+	add esp, 64
+
+	pop edi				; restore edi and esi
+	pop esi
+	ret
+
+clear_page_sse2:
+	push edi			; save edi
+
+	sub esp, 16			; save xmm0 (it holds current task state, saved on task switch)
+	movdqu [esp], xmm0
+
+	mov edi, [esp+24]		; dst address
+	mov ecx, 64			; 64 * 64 bytes = 4096 bytes to clear
+	pxor xmm0, xmm0
 
 .loop:
-	mov eax, [ebx]			; get the word at the source address
-	mov [ecx], eax			; store it at the dest address
-	add ebx, 4			; src address += sizeof(word)
-	add ecx, 4			; dst address += sizeof(word)
-	dec edx				; one less word to do
+	movntdq [edi], xmm0		; store 64 bytes bypassing the cache
+	movntdq [edi+16], xmm0
+	movntdq [edi+32], xmm0
+	movntdq [edi+48], xmm0
+	add edi, 64
+	dec ecx
 	jnz .loop
 
-	mov edx, cr0			; enable paging
-	or	edx, 0x80000000
-	mov cr0, edx
+	sfence				; order non temporal stores
+
+	movdqu xmm0, [esp]		; restore xmm0
+	add esp, 16
 
-	popf				; restore eflags and ebx
-	pop ebx
+	pop edi				; restore edi
 	ret